@@ -6,7 +6,7 @@
  ============================================================================
  */
 
-#define _XOPEN_SOURCE 500
+#define _XOPEN_SOURCE 600
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,10 +17,38 @@
 #include <stdint.h>
 #include <time.h>
 #include <signal.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <semaphore.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_MOVES
+#include <immintrin.h>
+#endif
 
+/**
+ * @brief 게임판 크기 상수입니다
+ * @remark SIZE 는 기본 크기이자 64비트 게임판 (board_t) 이 표현하는 크기이고,
+ *         --size 로 MIN_SIZE 이상 MAX_SIZE 이하의 크기를 고를 수 있다.
+ */
 #define SIZE 4
-unsigned int score = 0;
-unsigned int scheme = 0;
+#define MIN_SIZE                     3
+#define MAX_SIZE                     8
+
+#ifdef __GNUC__
+#define ALWAYS_INLINE                inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE                inline
+#endif
 
 /**
  * @brief 실행 인자값에 따른 실행모드 상수입니다
@@ -29,119 +57,777 @@ unsigned int scheme = 0;
 #define EXECUTE_TEST_MODE            0
 #define EXECUTE_COLOR_BLACKWHITE     1
 #define EXECUTE_COLOR_BLUERED        2
+#define EXECUTE_SIM_MODE             3
+#define EXECUTE_AI_MODE              4
+#define EXECUTE_REPLAY_MODE          5
+#define EXECUTE_BENCH_MODE           6
+#define EXECUTE_TRAIN_MODE           7
+#define EXECUTE_SERVE_MODE           8
+#define EXECUTE_VERIFY_MODE          9
+#define EXECUTE_TABLEBASE_MODE       10
+#define EXECUTE_STATS_MODE           11
+
+/**
+ * @brief 이동 방향 상수입니다
+ */
+#define MOVE_UP                      0
+#define MOVE_DOWN                    1
+#define MOVE_LEFT                    2
+#define MOVE_RIGHT                   3
+#define MOVE_COUNT                   4
+
+/**
+ * @brief 블럭이 이동한 뒤 새 블럭이 나타나기까지의 기본 대기 시간 (마이크로초)
+ */
+#define DEFAULT_DELAY                150000
+
+/**
+ * @brief 되돌리기 기록에 남기는 기본 단계 수 (2의 거듭제곱)
+ */
+#define HISTORY_DEFAULT_STEPS        65536
+
+/**
+ * @brief                       화면에 마지막으로 출력한 내용과 프레임 버퍼
+ * @remark                      drawBoard 는 shown 과 다른 칸만 커서 이동 후 다시 그리고,
+ *                              한 프레임을 frame 에 모은 뒤 write 한 번으로 출력한다.
+ * @param shown                 화면에 보이는 게임판
+ * @param shownScore            화면에 보이는 점수
+ * @param shownSize             화면에 보이는 게임판 크기
+ * @param shownAnalysis         점수 줄 오른쪽에 보이는 분석 결과
+ * @param valid                 false 이면 다음 프레임에서 모든 칸을 다시 그린다.
+ * @param length                frame 에 모인 바이트 수
+ */
+typedef struct {
+    unsigned int shown[MAX_SIZE][MAX_SIZE];
+    unsigned int shownScore;
+    unsigned int shownSize;
+    char shownAnalysis[96];
+    bool valid;
+    size_t length;
+    char frame[16384];
+} Screen;
+
+/**
+ * @brief                       크기가 자동으로 늘어나는 바이트 버퍼
+ */
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+/**
+ * @brief                       게임 하나의 리플레이 기록
+ * @param seed                  처음 두 블럭을 추가하기 전의 난수 상태
+ * @param checksum              지금까지의 게임판으로 계산한 체크섬
+ * @param count                 기록한 이동 수
+ * @param moves                 이동 하나당 2비트로 기록한 이동들
+ * @param size                  게임판 크기
+ * @param started               기록 중인지 여부
+ * @param file                  기록이 끝난 게임을 덧붙일 파일
+ */
+typedef struct {
+    uint64_t seed;
+    uint64_t checksum;
+    unsigned int count;
+    unsigned int size;
+    Buffer moves;
+    bool started;
+    FILE *file;
+} Replay;
+
+/**
+ * @brief                       되돌리기 기록의 한 단계, 새 블럭까지 추가된 뒤의 게임 상태
+ * @param packed                board[x][y] 의 지수의 낮은 4비트를 (size * x + y) 번째 니블에 담는다.
+ *                              4x4 이하는 board 하나에 들어가며 4x4 이면 packBoard 와 같은 배치이고,
+ *                              더 큰 게임판은 cells (8x8 이면 32 바이트) 를 쓴다.
+ * @param high                  지수가 16 이상인 칸은 (size * x + y) 번째 비트가 켜진다. (지수 31 까지)
+ * @param rng                   이 단계의 난수 상태
+ * @param checksum              이 단계까지의 리플레이 체크섬 (기록하지 않으면 0)
+ * @param score                 이 단계의 점수
+ * @param direction             이 단계로 온 이동 방향
+ */
+typedef struct {
+    union {
+        uint64_t board;
+        uint8_t cells[MAX_SIZE * MAX_SIZE / 2];
+    } packed;
+    uint64_t high;
+    uint64_t rng;
+    uint64_t checksum;
+    unsigned int score;
+    unsigned int direction;
+} HistoryStep;
+
+/**
+ * @brief                       미리 할당한 링 버퍼에 담는 되돌리기/다시 하기 기록
+ * @remark                      단계 번호는 계속 늘어나고 i 번째 단계는 steps[i & mask] 에 있다.
+ *                              first 부터 last 까지가 남아 있는 단계이고 current 가 지금 게임판이다.
+ *                              단계가 capacity 를 넘으면 가장 오래된 단계부터 덮어쓰므로 긴 게임에서도
+ *                              메모리는 늘지 않는다.
+ * @param mask                  capacity - 1
+ */
+typedef struct {
+    HistoryStep *steps;
+    uint64_t mask;
+    uint64_t first;
+    uint64_t current;
+    uint64_t last;
+} History;
+
+/**
+ * @brief                       게임 한 판의 상태를 모두 담는 구조체
+ * @remark                      전역 상태가 없으므로 한 프로세스 안에서 여러 게임을
+ *                              독립적으로 (다른 스레드에서도) 진행할 수 있다.
+ * @param board                 게임판, board[x][y] 는 x 번째 열 y 번째 행의 지수
+ * @param size                  게임판 크기, board 의 앞쪽 size x size 칸만 사용한다.
+ * @param kernels               size 에 특수화된 게임판 함수들 (setBoardSize 참고)
+ * @param empty                 빈 칸 마스크, board[x][y] 가 빈 칸이면 (8 * x + y) 번째 비트가 켜진다.
+ * @param pairs                 board[x][y] 가 빈 칸이 아니고 아래 (y + 1) 나 오른쪽 (x + 1) 칸과
+ *                              같으면 (8 * x + y) 번째 비트가 켜진다.
+ *                              두 마스크는 이동과 addRandom 이 갱신하고, board 를 직접 바꾼 뒤에는
+ *                              refreshMasks 를 호출해야 한다.
+ * @param score                 현재 점수
+ * @param rng                   addRandom 에서 사용하는 난수 상태 (nextRandom 참고)
+ * @param scheme                화면 출력에 사용할 색깔 스키마
+ * @param delay                 이동 후 새 블럭이 나타나기까지의 대기 시간 (마이크로초)
+ * @param screen                터미널에 출력한 상태, 화면에 그리는 게임만 가지며 그리지 않으면 NULL
+ *                              (프레임 버퍼가 크므로 게임을 복사하는 롤아웃, 분석, 테스트가 함께 복사하지 않도록
+ *                              UI 쪽에서 따로 두고 가리킨다)
+ * @param replay                리플레이 기록, 기록하지 않으면 NULL
+ * @param history               되돌리기 기록, 기록하지 않으면 NULL
+ * @param tablebase             3x3 게임의 힌트에 사용할 tablebase, 없으면 NULL
+ * @param analysis              게임판을 미리 분석하는 배경 스레드, 없으면 NULL
+ */
+typedef struct Kernels Kernels;
+typedef struct Tablebase Tablebase;
+typedef struct Analysis Analysis;
+
+typedef struct {
+    unsigned int board[MAX_SIZE][MAX_SIZE];
+    unsigned int size;
+    const Kernels *kernels;
+    uint64_t empty;
+    uint64_t pairs;
+    unsigned int score;
+    uint64_t rng;
+    unsigned int scheme;
+    unsigned int delay;
+    Screen *screen;
+    Replay *replay;
+    History *history;
+    Tablebase *tablebase;
+    Analysis *analysis;
+} Game;
+
 
+/**
+ * @brief 색깔 스키마 상수입니다
+ * @remark 블록의 지수 0 ~ 15 마다 배경색과 글자색 (256색) 한 쌍을 가지며, 더 큰 지수는 마지막 색을 쓴다.
+ */
+#define TILE_LEVELS                  32
+#define SCHEME_COLORS                16
+#define SCHEME_CUSTOM                3
+#define SCHEME_COUNT                 4
+
+static const unsigned int builtinSchemes[SCHEME_CUSTOM][2 * SCHEME_COLORS] = {
+    // original
+    {8, 255, 1, 255, 2, 255, 3, 255, 4, 255, 5, 255, 6, 255, 7,
+     255, 9, 0, 10, 0, 11, 0, 12, 0, 13, 0, 14, 0, 255, 0, 255, 0},
+    // blackwhite
+    {232, 255, 234, 255, 236, 255, 238, 255, 240, 255, 242, 255, 244, 255,
+     246, 0, 248, 0, 249, 0, 250, 0, 251, 0, 252, 0, 253, 0, 254, 0, 255, 0},
+    // bluered
+    {235, 255, 63, 255, 57, 255, 93, 255, 129, 255, 165, 255, 201, 255, 200, 255,
+     199, 255, 198, 255, 197, 255, 196, 255, 196, 255, 196, 255, 196, 255, 196, 255}
+};
+
+/**
+ * @brief                       화면에 바로 출력할 수 있는 문자열과 그 길이
+ * @remark                      가장 긴 색깔 escape (34), 7칸보다 긴 값 (10), 색깔 초기화 (3) 가 모두 들어가는 크기
+ */
+typedef struct {
+    char text[64];
+    size_t length;
+} Escape;
+
+/**
+ * @brief                       색깔 스키마 하나의 블록 한 줄 문자열들
+ * @param blank                 지수별 색깔 + 빈 7칸 + 색깔 초기화
+ * @param value                 지수별 색깔 + 가운데 정렬된 7칸 값 + 색깔 초기화
+ */
+typedef struct {
+    Escape blank[TILE_LEVELS];
+    Escape value[TILE_LEVELS];
+} ColorScheme;
 
+static ColorScheme colorSchemes[SCHEME_COUNT];
 
 /**
  * @author                          박소연 (pparksso0308@gmail.com)
  * @brief                           화면에 출력될 블록들의 색깔 스키마를 설정한다.
- * @param unsigned int value        블록들에 저장되어 있는 값
- * @param char * color              블록들의 색깔을 저장할 변수
- * @param size_t length             color 변수의 크기 설정
+ * @remark                          블록 한 줄을 그리는 데 필요한 escape 문자열과 값 표시를
+ *                                  지수마다 미리 만들어 두므로 화면을 그릴 때는 복사만 하면 된다.
+ * @param ColorScheme scheme        만들 색깔 스키마
+ * @param unsigned int colors       지수 0 ~ 15 의 배경색, 글자색 쌍
 */
-void getColor(unsigned int value, char *color, size_t length)
+void buildColorScheme(ColorScheme *scheme, const unsigned int colors[2 * SCHEME_COLORS])
+{
+    unsigned int value, pair, t;
+    // 256-color numbers, masked so that the longest escape visibly fits
+    char color[40];
+    char label[12];
+
+    for (value = 0; value < TILE_LEVELS; value++) {
+        pair = value < SCHEME_COLORS ? value : SCHEME_COLORS - 1;
+        snprintf(color, sizeof(color), "\033[38;5;%u;48;5;%um", colors[2 * pair + 1] & 0xFF, colors[2 * pair] & 0xFF);
+        if (value != 0) {
+            snprintf(label, sizeof(label), "%u", 1u << value);
+            // values wider than the 7 columns of a block are shown without padding
+            t = strlen(label) < 7 ? 7 - strlen(label) : 0;
+            snprintf(scheme->value[value].text, sizeof(scheme->value[value].text), "%s%*s%s%*s\033[m",
+                     color, t - t / 2, "", label, t / 2, "");
+        } else {
+            snprintf(scheme->value[value].text, sizeof(scheme->value[value].text), "%s   ·   \033[m", color);
+        }
+        snprintf(scheme->blank[value].text, sizeof(scheme->blank[value].text), "%s       \033[m", color);
+        scheme->value[value].length = strlen(scheme->value[value].text);
+        scheme->blank[value].length = strlen(scheme->blank[value].text);
+    }
+}
+
+/**
+ * @brief                       기본 색깔 스키마들을 만든다. 화면을 그리기 전에 한 번 호출해야 한다.
+ */
+void initColorSchemes(void)
 {
+    static bool initialized = false;
+    unsigned int i;
 
-    unsigned int original[] = {8, 255, 1, 255, 2, 255, 3, 255, 4, 255, 5, 255, 6, 255, 7,
-                          255, 9, 0, 10, 0, 11, 0, 12, 0, 13, 0, 14, 0, 255, 0, 255, 0};
-    unsigned int blackwhite[] = {232, 255, 234, 255, 236, 255, 238, 255, 240, 255, 242, 255, 244, 255,
-                            246, 0, 248, 0, 249, 0, 250, 0, 251, 0, 252, 0, 253, 0, 254, 0, 255, 0};
-    unsigned int bluered[] = {235, 255, 63, 255, 57, 255, 93, 255, 129, 255, 165, 255, 201, 255, 200, 255,
-                        199, 255, 198, 255, 197, 255, 196, 255, 196, 255, 196, 255, 196, 255, 196, 255};
+    if (initialized) {
+        return;
+    }
+    for (i = 0; i < SCHEME_CUSTOM; i++) {
+        buildColorScheme(&colorSchemes[i], builtinSchemes[i]);
+    }
+    // until a file is loaded the custom scheme looks like the original one
+    buildColorScheme(&colorSchemes[SCHEME_CUSTOM], builtinSchemes[0]);
+    initialized = true;
+}
 
-    unsigned int *schemes[] = {original, blackwhite, bluered};
-    unsigned int *background = schemes[scheme] + 0;
-    unsigned int *foreground = schemes[scheme] + 1;
+/**
+ * @brief                       파일에서 사용자 색깔 스키마를 읽어 SCHEME_CUSTOM 으로 등록한다.
+ * @remark                      파일에는 지수 0 부터 차례로 "배경색 글자색" 쌍을 적는다. (256색 번호)
+ *                              # 부터 줄 끝까지는 주석이며, 적지 않은 지수는 마지막 쌍을 반복한다.
+ * @param const char path       스키마 파일 경로
+ * @return bool                 읽기에 실패하거나 색깔이 하나도 없으면 false
+ */
+bool loadColorScheme(const char *path)
+{
+    unsigned int colors[2 * SCHEME_COLORS];
+    unsigned int count = 0;
+    unsigned int color;
+    char line[256];
+    char *p, *end;
+    FILE *file = fopen(path, "r");
 
-    if (value > 0)  {
-        while (value--) {
-            if (background + 2 < schemes[scheme] + sizeof(original)) {
-                background += 2;
-                foreground += 2;
+    if (file == NULL) {
+        return false;
+    }
+    while (count < 2 * SCHEME_COLORS && fgets(line, sizeof(line), file) != NULL) {
+        p = strchr(line, '#');
+        if (p != NULL) {
+            *p = '\0';
+        }
+        for (p = line; count < 2 * SCHEME_COLORS; p = end) {
+            color = strtoul(p, &end, 10);
+            if (end == p) {
+                break;
             }
+            colors[count++] = color > 255 ? 255 : color;
+        }
+    }
+    fclose(file);
+    if (count < 2) {
+        return false;
+    }
+    for (; count < 2 * SCHEME_COLORS; count++) {
+        colors[count] = colors[count - 2];
+    }
+    initColorSchemes();
+    buildColorScheme(&colorSchemes[SCHEME_CUSTOM], colors);
+    return true;
+}
+
+/**
+ * @brief 실행 통계 상수입니다
+ * @remark --stats 로 실행하면 끝날 때와 SIGUSR1 을 받았을 때 카운터와 단계별 시간을 stderr 로 출력한다.
+ *         --stats 가 없으면 STAT_ADD 와 statsClock 은 statsEnabled 분기 하나만 지나고 아무것도 세지 않는다.
+ *         -DNO_STATS 로 컴파일하면 그 분기도 없어진다.
+ */
+#ifndef NO_STATS
+#define STATS
+#endif
+#define PHASE_INPUT                  0
+#define PHASE_MOVE                   1
+#define PHASE_SPAWN                  2
+#define PHASE_RENDER                 3
+#define PHASE_SLEEP                  4
+#define PHASE_COUNT                  5
+
+/**
+ * @brief                       스레드마다 따로 세는 실행 통계
+ * @param lines                 이동 함수가 밀어 본 줄 수 (slideLineN 과 벡터 커널)
+ * @param slides                기준 구현 slideArray 호출 수
+ * @param targetSteps           findTarget 이 목표 위치를 찾으며 검사한 칸 수
+ * @param merges                merges[v] 는 지수 v 인 블럭이 만들어진 merge 수
+ * @param rotations             rotateBoard 호출 수
+ * @param spawns                addRandom 호출 수
+ * @param frames                drawBoard 로 출력한 프레임 수
+ * @param bytes                 터미널에 쓴 바이트 수
+ * @param nanos                 PHASE_INPUT ~ PHASE_SLEEP 단계마다 보낸 시간 (나노초)
+ */
+typedef struct {
+    uint64_t lines;
+    uint64_t slides;
+    uint64_t targetSteps;
+    uint64_t merges[TILE_LEVELS];
+    uint64_t rotations;
+    uint64_t spawns;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t nanos[PHASE_COUNT];
+} Stats;
+
+static bool statsEnabled = false;
+static volatile sig_atomic_t statsRequested = 0;
+
+uint64_t monotonicNanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#ifdef STATS
+// counters are per thread, so the hot paths never share a cache line or take a lock,
+// and mergeStats adds them to totalStats when a thread is done
+static __thread Stats threadStats;
+static Stats totalStats;
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+#define STAT_ADD(field, n)           (statsEnabled ? (void) (threadStats.field += (n)) : (void) 0)
+#define STAT_MERGE(value)            STAT_ADD(merges[(value) < TILE_LEVELS ? (value) : TILE_LEVELS - 1], 1)
+#define STAT_PHASE(phase, start)     (statsEnabled ? (void) (threadStats.nanos[phase] += monotonicNanos() - (start)) \
+                                                   : (void) 0)
+
+static ALWAYS_INLINE uint64_t statsClock(void)
+{
+    return statsEnabled ? monotonicNanos() : 0;
+}
+#else
+#define STAT_ADD(field, n)           ((void) 0)
+#define STAT_MERGE(value)            ((void) 0)
+#define STAT_PHASE(phase, start)     ((void) (start))
+
+static ALWAYS_INLINE uint64_t statsClock(void)
+{
+    return 0;
+}
+#endif
+
+static void requestStats(int signum)
+{
+    (void) signum;
+    statsRequested = 1;
+}
+
+/**
+ * @brief                       이 스레드의 통계를 totalStats 에 더하고 0 으로 되돌린다.
+ * @remark                      작업 스레드는 끝나기 전에 호출하고, printStats 는 출력하기 전에 호출한다.
+ */
+void mergeStats(void)
+{
+#ifdef STATS
+    uint64_t *from = (uint64_t *) &threadStats;
+    uint64_t *to = (uint64_t *) &totalStats;
+    size_t i;
+
+    if (!statsEnabled) {
+        return;
+    }
+    pthread_mutex_lock(&statsLock);
+    // Stats holds nothing but uint64_t counters
+    for (i = 0; i < sizeof(Stats) / sizeof(uint64_t); i++) {
+        to[i] += from[i];
+    }
+    pthread_mutex_unlock(&statsLock);
+    memset(&threadStats, 0, sizeof(threadStats));
+#endif
+}
+
+/**
+ * @brief                       --stats 로 실행했으면 이 스레드와 끝난 작업 스레드들의 통계를 합쳐 출력한다.
+ * @remark                      시그널 핸들러에서 부르면 안 된다. 핸들러는 플래그만 세우고 이벤트 루프가 부른다.
+ */
+void printStats(FILE *file)
+{
+#ifdef STATS
+    static const char *const phases[PHASE_COUNT] = {"input wait", "move", "spawn", "render", "sleep"};
+    Stats snapshot;
+    const Stats *stats = &snapshot;
+    unsigned int i;
+
+    if (!statsEnabled) {
+        return;
+    }
+    mergeStats();
+    pthread_mutex_lock(&statsLock);
+    snapshot = totalStats;
+    pthread_mutex_unlock(&statsLock);
+    fprintf(file, "lines slid     %llu\n", (unsigned long long) stats->lines);
+    fprintf(file, "slideArray     %llu\n", (unsigned long long) stats->slides);
+    fprintf(file, "findTarget     %llu steps\n", (unsigned long long) stats->targetSteps);
+    fprintf(file, "rotations      %llu\n", (unsigned long long) stats->rotations);
+    fprintf(file, "spawns         %llu\n", (unsigned long long) stats->spawns);
+    fprintf(file, "frames         %llu\n", (unsigned long long) stats->frames);
+    fprintf(file, "bytes written  %llu\n", (unsigned long long) stats->bytes);
+    fprintf(file, "merges        ");
+    for (i = 1; i < TILE_LEVELS; i++) {
+        if (stats->merges[i] > 0) {
+            fprintf(file, " %u:%llu", 1u << i, (unsigned long long) stats->merges[i]);
         }
     }
+    fprintf(file, "\n");
+    for (i = 0; i < PHASE_COUNT; i++) {
+        fprintf(file, "%-14s %.3f ms\n", phases[i], stats->nanos[i] / 1e6);
+    }
+    fflush(file);
+#else
+    if (statsEnabled) {
+        fprintf(file, "statistics are not compiled in (built with NO_STATS)\n");
+    }
+#endif
+}
+
+/**
+ * @brief                       프레임 버퍼에 문자열을 덧붙인다. 버퍼가 가득 차면 버린다.
+ */
+void appendFrame(Screen *screen, const char *text, size_t length)
+{
+    if (screen->length + length <= sizeof(screen->frame)) {
+        memcpy(screen->frame + screen->length, text, length);
+        screen->length += length;
+    }
+}
 
-    snprintf(color, length, "\033[38;5;%d;48;5;%dm", *foreground, *background);
+void appendFormat(Screen *screen, const char *format, ...)
+{
+    size_t space = sizeof(screen->frame) - screen->length;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(screen->frame + screen->length, space, format, args);
+    va_end(args);
+    if (length > 0 && (size_t) length < space) {
+        screen->length += length;
+    }
 }
 
+/**
+ * @brief                       프레임 버퍼에 커서 이동 escape 를 덧붙인다.
+ * @param unsigned int row      이동할 줄 (1 부터)
+ * @param unsigned int column   이동할 칸 (1 부터)
+ */
+void appendCursor(Screen *screen, unsigned int row, unsigned int column)
+{
+    char text[16];
+    char digits[8];
+    size_t length = 0;
+    unsigned int n, values[2] = {row, column};
+    unsigned int i;
 
+    text[length++] = '\033';
+    text[length++] = '[';
+    for (i = 0; i < 2; i++) {
+        n = 0;
+        do {
+            digits[n++] = (char) ('0' + values[i] % 10);
+            values[i] /= 10;
+        } while (values[i] > 0 && n < sizeof(digits));
+        while (n > 0) {
+            text[length++] = digits[--n];
+        }
+        text[length++] = i == 0 ? ';' : 'H';
+    }
+    appendFrame(screen, text, length);
+}
 
 /**
  * @author                      박소연 (pparksso0308@gmail.com)
- * @brief                       화면에 블록의 값을 출력한다.
- * @param unsigned int board    화면에 출력할 게임판 정보
- * @param unit8_t x_index       게임판의 x index 값
- * @param unit8_t y_index       게임판의 y index 값
+ * @brief                       블록 하나 (3줄) 를 프레임 버퍼에 그린다.
+ * @param Game game             화면에 출력할 게임
+ * @param unsigned int x        게임판의 x index 값
+ * @param unsigned int y        게임판의 y index 값
  */
-void printValue(unsigned int board[SIZE][SIZE], unsigned int x_index, unsigned int y_index )
+void drawCell(Game *game, unsigned int x, unsigned int y)
 {
-    if (board[x_index][y_index] != 0) {
-        char s[8];
-        snprintf(s, 8, "%u", 1 << board[x_index][y_index]);
+    const ColorScheme *scheme = &colorSchemes[game->scheme];
+    unsigned int value = game->board[x][y] < TILE_LEVELS ? game->board[x][y] : TILE_LEVELS - 1;
+    const Escape *line;
+    unsigned int i;
 
-        unsigned int t = 7 - strlen(s);
-        printf("%*s%s%*s", t - t / 2, "", s, t / 2, "");
-    } else {
-        printf("   ·   ");
+    for (i = 0; i < 3; i++) {
+        line = i == 1 ? &scheme->value[value] : &scheme->blank[value];
+        // the board starts on the third line of the screen, 3 lines and 7 columns per block
+        appendCursor(game->screen, 3 + 3 * y + i, 1 + 7 * x);
+        appendFrame(game->screen, line->text, line->length);
     }
+    game->screen->shown[x][y] = game->board[x][y];
 }
 
+void drawAnalysis(Game *game);
+
 /**
  * @author                      박소연 (pparksso0308@gmail.com)
  * @brief                       화면에 게임판을 출력한다.
- * @param unsigned int board    화면에 출력할 게임판 정보
+ * @remark                      이전 프레임과 달라진 블록과 점수만 다시 그리고, write 한 번으로 출력한다.
+ * @param Game game             화면에 출력할 게임
  */
-void drawBoard(unsigned int board[SIZE][SIZE])
+void drawBoard(Game *game)
 {
-    unsigned int x; 
+    Screen *screen = game->screen;
+    const unsigned int n = game->size;
+    unsigned int x;
     unsigned int y;
-    char color[40];
-    char reset[] = "\033[m";
+    const char *frame;
+    size_t length;
+    ssize_t written;
+    uint64_t start = statsClock();
 
-    printf("\033[H");
-    printf("2048.c %17d pts\n\n", score);
+    screen->length = 0;
+    if (screen->shownSize != n) {
+        screen->valid = false;
+        screen->shownSize = n;
+    }
+    if (!screen->valid) {
+        // the board may have been resized, so start from a blank screen
+        appendFrame(screen, "\033[2J", 4);
+    }
+    if (!screen->valid || screen->shownScore != game->score) {
+        appendFormat(screen, "\033[H2048.c %17d pts", game->score);
+        screen->shownScore = game->score;
+    }
+    for (y = 0; y < n; y++) {
+        for (x = 0; x < n; x++) {
+            if (!screen->valid || screen->shown[x][y] != game->board[x][y]) {
+                drawCell(game, x, y);
+            }
+        }
+    }
+    if (game->analysis != NULL) {
+        drawAnalysis(game);
+    }
+    // the message line below the board may have been overwritten, so it is always redrawn
+    appendFormat(screen, "\033[%u;1H     ←,↑,→,↓, u, i or q     \033[%u;1H", 4 + 3 * n, 4 + 3 * n);
+    screen->valid = true;
 
-    for (y = 0; y < SIZE; y++) {
-        for (x = 0; x < SIZE; x++) {
-            getColor(board[x][y], color, 40);
-            printf("%s", color);
-            printf("       ");
-            printf("%s", reset);
+    // messages are printed with printf, so keep them in order with the frame
+    fflush(stdout);
+    frame = screen->frame;
+    length = screen->length;
+    while (length > 0) {
+        written = write(STDOUT_FILENO, frame, length);
+        if (written <= 0) {
+            break;
         }
-        printf("\n");
+        frame += written;
+        length -= written;
+        STAT_ADD(bytes, written);
+    }
+    STAT_ADD(frames, 1);
+    STAT_PHASE(PHASE_RENDER, start);
+}
 
-        for (x = 0; x < SIZE; x++) {
-            getColor(board[x][y], color, 40);
-            printf("%s", color);
-            printValue(board, int x, int y);
-            printf("%s", reset);
+/**
+ * @brief                       난수 상태를 초기화한다. (splitmix64)
+ * @remark                      같은 seed 라도 stream 이 다르면 서로 독립적인 난수열이 만들어지므로
+ *                              스레드나 게임마다 stream 을 다르게 주면 된다.
+ * @param uint64_t seed         난수 초기값
+ * @param uint64_t stream       난수열 번호
+ * @return uint64_t             nextRandom 에 넘길 난수 상태 (0 이 아님)
+ */
+uint64_t seedRandom(uint64_t seed, uint64_t stream)
+{
+    uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z != 0 ? z : 1;
+}
+
+/**
+ * @brief                       32비트 난수를 만든다. (xorshift64*)
+ * @remark                      rand() 와 달리 숨겨진 공유 상태가 없으므로 스레드마다 상태를 두면 된다.
+ * @param uint64_t rng          난수 상태
+ */
+uint32_t nextRandom(uint64_t *rng)
+{
+    uint64_t x = *rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/**
+ * @brief                       64비트 난수를 만든다. 앞의 32비트 난수가 높은 쪽이다.
+ * @remark                      한 식에서 nextRandom 을 두 번 부르면 순서가 컴파일러마다 다르므로 문장을 나눈다.
+ */
+uint64_t nextRandom64(uint64_t *rng)
+{
+    uint64_t high = nextRandom(rng);
+    uint64_t low = nextRandom(rng);
+    return high << 32 | low;
+}
+
+/**
+ * @brief                       0 이상 n 미만의 난수를 만든다.
+ */
+unsigned int randomBelow(uint64_t *rng, unsigned int n)
+{
+    return (unsigned int) (((uint64_t) nextRandom(rng) * n) >> 32);
+}
+
+/**
+ * @brief                       mask 에서 k 번째 (0 부터) 로 낮은 켜진 비트의 위치를 찾는다.
+ * @remark                      바이트마다의 누적 popcount 를 64비트 곱셈 하나로 구해서 비트가 있는
+ *                              바이트를 찾고, 그 바이트 안에서 같은 방법을 한 번 더 쓰므로 반복문이 없다.
+ *                              BMI2 를 지원하는 CPU 에서는 initVectorKernels 가 PDEP 를 쓰는 함수로 바꾼다.
+ * @param uint64_t mask         비트 마스크
+ * @param unsigned int k        popcount(mask) 보다 작은 수
+ * @return unsigned int         비트 위치 (0 ~ 63)
+ */
+static unsigned int selectBitPortable(uint64_t mask, unsigned int k)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t sums, bits, place;
+
+    sums = mask - ((mask >> 1) & 0x5555555555555555ULL);
+    sums = (sums & 0x3333333333333333ULL) + ((sums >> 2) & 0x3333333333333333ULL);
+    // byte i: number of set bits in bytes 0 ~ i
+    sums = ((sums + (sums >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * ones;
+    // bytes whose running count is still <= k come before the wanted one
+    place = (((((k * ones) | highs) - sums) & highs) >> 7) * ones >> 56 << 3;
+    k -= (unsigned int) ((sums << 8) >> place) & 0xFF;
+    // the same within the byte, one bit per byte
+    bits = (((mask >> place) & 0xFF) * ones) & 0x8040201008040201ULL;
+    sums = (((((bits & ~highs) + ~highs) | bits) & highs) >> 7) * ones;
+    return (unsigned int) (place + (((((((k * ones) | highs) - sums) & highs) >> 7) * ones) >> 56));
+}
+
+#ifdef VECTOR_MOVES
+__attribute__((target("bmi2"))) static unsigned int selectBitBmi2(uint64_t mask, unsigned int k)
+{
+    return (unsigned int) __builtin_ctzll(_pdep_u64((uint64_t) 1 << k, mask));
+}
+#endif
+
+static unsigned int (*selectKernel)(uint64_t mask, unsigned int k) = selectBitPortable;
+
+/**
+ * @brief                       CPU 에 맞게 고른 selectBit 구현을 호출한다. (selectBitPortable 참고)
+ */
+unsigned int selectBit(uint64_t mask, unsigned int k)
+{
+    return selectKernel(mask, k);
+}
+
+/**
+ * @brief                       columns 개의 열과 rows 개의 행에 해당하는 빈 칸 마스크 비트들 (Game.empty 참고)
+ */
+static ALWAYS_INLINE uint64_t boardMask(unsigned int columns, unsigned int rows)
+{
+    return (((uint64_t) 1 << rows) - 1) * (0x0101010101010101ULL >> (8 * (MAX_SIZE - columns)));
+}
+
+/**
+ * @brief                       게임판 크기별로 특수화된 함수 테이블
+ * @remark                      DEFINE_KERNELS 가 MIN_SIZE 부터 MAX_SIZE 까지 크기마다 하나씩 만든다.
+ *                              각 함수 안에서 크기가 상수이므로 컴파일러가 반복문을 펼치고
+ *                              인덱스 계산을 상수로 접을 수 있다.
+ */
+struct Kernels {
+    unsigned int size;
+    bool (*slideArray)(Game *game, unsigned int index);
+    void (*rotateBoard)(unsigned int board[MAX_SIZE][MAX_SIZE]);
+    bool (*move[MOVE_COUNT])(Game *game);
+    void (*refreshMasks)(Game *game);
+};
+
+/**
+ * @author                          이원준 (21jun7654@gmail.com)
+ * @brief                           게임판의 한 줄의 블럭들을 첫 칸 쪽으로 이동하는 함수
+ *                                  이동 중 블럭끼리 merge되는 경우도 발생함
+ * @remark                          블럭마다 마지막으로 놓은 블럭과 같고 그 블럭이 아직 merge 되지
+ *                                  않았으면 merge 하고, 아니면 다음 빈 자리로 옮긴다.
+ *                                  줄의 칸들을 first, first + step, ... 으로 찾으므로 step 의 부호와
+ *                                  크기만 바꾸면 네 방향 모두 게임판을 회전하지 않고 처리할 수 있다.
+ *                                  결과는 아래의 slideArrayN (findTarget) 과 같아야 하며, verify 가 둘을 비교한다.
+ * @param Game game                 게임, merge 가 일어나면 점수가 증가한다.
+ * @param unsigned int first        줄의 첫 칸 (이동하는 쪽 끝) 의 &board[0][0] 기준 위치
+ * @param int step                  다음 칸까지의 거리, 열 방향은 1, 행 방향은 MAX_SIZE (반대쪽은 음수)
+ * @param unsigned int n            게임판 크기 (DEFINE_KERNELS 에서 상수로 넘긴다)
+ * @return bool success             하나의 블럭이라도 이동했다면 true 반환한다.
+ */
+static ALWAYS_INLINE bool slideLineN(Game *game, unsigned int first, const int step, const unsigned int n)
+{
+    unsigned int *cells = &game->board[0][0] + first;
+    bool success = false;
+    bool mergeable = false;
+    unsigned int i, t = 0;
+    unsigned int value;
+
+    STAT_ADD(lines, 1);
+    for (i = 0; i < n; i++) {
+        value = cells[step * (int) i];
+        if (value == 0) {
+            continue;
         }
-        printf("\n");
-        for (x = 0; x < SIZE; x++) {
-            getColor(board[x][y], color, 40);
-            printf("%s", color);
-            printf("       ");
-            printf("%s", reset);
+        if (mergeable && cells[step * (int) (t - 1)] == value) {
+            // merge (increase power of two), the merged tile cannot merge again
+            cells[step * (int) (t - 1)] = value + 1;
+            game->score += (unsigned int) 1 << (value + 1);
+            STAT_MERGE(value + 1);
+            cells[step * (int) i] = 0;
+            mergeable = false;
+            success = true;
+        } else {
+            if (t != i) {
+                cells[step * (int) t] = value;
+                cells[step * (int) i] = 0;
+                success = true;
+            }
+            t++;
+            mergeable = true;
         }
-        printf("\n");
     }
-    printf("\n");
-    printf("        ←,↑,→,↓ or q        \n");
-    printf("\033[A"); // one line up
+    return success;
 }
 
 /**
  * @author                          이원준 (21jun7654@gmail.com)
  * @brief                           블럭이 이동할 수 있는 위치를 찾아 반환하는 함수
- * @param unsigned int array[SIZE]  검사할 블럭이 속한 행
+ * @param unsigned int array[]      검사할 블럭이 속한 행
  * @param unsigned int x            검사할 블럭의 위치 정보
  * @param unsigned int stop         중복검사를 방지하기 위한 인덱스
  * @return unsigned int             블럭이 이동할 수 있는 위치를 찾으면 해당 위치를 반환 (t+1),
  *                                  블럭이 stop 에 의해 더이상 검사를 할 필요가 없는 경우 (t),
  *                                  블럭이 이동할 수 있는 위치가 없는 경우 원래 위치 반환(제자리) (x)
  */
-unsigned int findTarget(unsigned int array[SIZE], unsigned int x, unsigned int stop)
+static ALWAYS_INLINE unsigned int findTarget(unsigned int array[MAX_SIZE], unsigned int x, unsigned int stop)
 {
     unsigned int t;
     // if the position is already on the first, don't evaluate
@@ -149,6 +835,7 @@ unsigned int findTarget(unsigned int array[SIZE], unsigned int x, unsigned int s
         return x;
     }
     for (t = x - 1;; t--) {
+        STAT_ADD(targetSteps, 1);
         if (array[t] != 0) {
             if (array[t] != array[x]) {
                 // merge is not possible, take next position
@@ -168,19 +855,24 @@ unsigned int findTarget(unsigned int array[SIZE], unsigned int x, unsigned int s
 
 /**
  * @author                          이원준 (21jun7654@gmail.com)
- * @brief                           게임판의 블럭들을 이동하는 함수       
+ * @brief                           게임판의 블럭들을 이동하는 함수
  *                                  이동 중 블럭끼리 merge되는 경우도 발생함
- * @param unsigned int board        게임판
+ * @remark                          처음 구현의 findTarget/stop 알고리즘을 그대로 둔다. 이동 함수들은 slideLineN 을
+ *                                  쓰므로, initMoveTables 와 verifyMoves 는 이 함수를 독립된 기준으로 삼는다.
+ * @param Game game                 게임, merge 가 일어나면 점수가 증가한다.
  * @param unsigned int index        검사할 행의 인덱스
+ * @param unsigned int n            게임판 크기 (DEFINE_KERNELS 에서 상수로 넘긴다)
  * @return bool success             게임판의 한 행의 블럭들이 이동되었는지 여부
- *                                  하나의 블럭이라도 이동했다면 true 반환한다.             
+ *                                  하나의 블럭이라도 이동했다면 true 반환한다.
  */
-bool slideArray(unsigned int board[SIZE][SIZE], unsigned int index)
+static ALWAYS_INLINE bool slideArrayN(Game *game, unsigned int index, const unsigned int n)
 {
+    unsigned int (*board)[MAX_SIZE] = game->board;
     bool success = false;
     unsigned int x, t, stop = 0;
 
-    for (x = 0; x < SIZE; x++) {
+    STAT_ADD(slides, 1);
+    for (x = 0; x < n; x++) {
         if (board[index][x] != 0) {
             t = findTarget(board[index], x, stop);
             // if target is not original position, then move or merge
@@ -188,13 +880,14 @@ bool slideArray(unsigned int board[SIZE][SIZE], unsigned int index)
                 // if target is zero, this is a move
                 if (board[index][t] == 0) {
                     board[index][t] = board[index][x];
-                } 
+                }
                 else {
                     if (board[index][t] == board[index][x]) {
                         // merge (increase power of two)
                         board[index][t]++;
                         // increase score
-                        score += (unsigned int) 1 << board[index][t];
+                        game->score += (unsigned int) 1 << board[index][t];
+                        STAT_MERGE(board[index][t]);
                         // set stop to avoid double merge
                         stop = t + 1;
                     }
@@ -210,13 +903,15 @@ bool slideArray(unsigned int board[SIZE][SIZE], unsigned int index)
 /**
  * @author                          이원준 (21jun7654@gmail.com)
  * @brief                           게임판을 반시계 방향으로 90도 회전시키는 함수
- *                                  실제 구현은 4x4 배열의 원소들을 옮겨서 회전과 같은 효과를 냈다.
+ *                                  실제 구현은 n x n 배열의 원소들을 옮겨서 회전과 같은 효과를 냈다.
  * @param unsigned int board        게임판        
+ * @param unsigned int n            게임판 크기
  */
-void rotateBoard(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE void rotateBoardN(unsigned int board[MAX_SIZE][MAX_SIZE], const unsigned int n)
 {
-    unsigned int i, j, n = SIZE;
+    unsigned int i, j;
     unsigned int tmp;
+    STAT_ADD(rotations, 1);
     for (i = 0; i < n / 2; i++) {
         for (j = i; j < n - i - 1; j++) {
             tmp = board[i][j];
@@ -230,18 +925,19 @@ void rotateBoard(unsigned int board[SIZE][SIZE])
 /**
  * @author                          이원준 (21jun7654@gmail.com)
  * @brief                           게임판의 블럭들을 위로 이동하는 함수
- *                                  모든 move 함수들은 rotateBoard를 수행해서 방향을 맞추고,
- *                                  moveUp 함수를 호출해서 move작업을 수행한다.
- * @remark                          4x4 배열을 4x1 씩 나누어 4번의 slideArray 함수를 호출한다.
- * @param unsigned int board        게임판       
+ * @remark                          n x n 배열을 n x 1 씩 나누어 n번의 slideLine 함수를 호출한다.
+ *                                  다른 방향도 줄의 시작과 간격만 바꿔서 같은 함수로 처리하므로
+ *                                  게임판을 회전하지 않는다.
+ * @param Game game                 게임
+ * @param unsigned int n            게임판 크기
  * @return bool success             작업의 성공 여부
  */
-bool moveUp(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE bool moveUpN(Game *game, const unsigned int n)
 {
     bool success = false;
     unsigned int x;
-    for (x = 0; x < SIZE; x++) {
-        success |= slideArray(board, x);
+    for (x = 0; x < n; x++) {
+        success |= slideLineN(game, x * MAX_SIZE, 1, n);
     }
     return success;
 }
@@ -249,364 +945,7855 @@ bool moveUp(unsigned int board[SIZE][SIZE])
 /**
  * @author                          이원준 (21jun7654@gmail.com)
  * @brief                           게임판의 블럭들을 왼쪽으로 이동하는 함수
- *                                  반 시계 벙향으로 90도 게임판을 회전시키고,
- *                                  moveUp 이후에 반 시계 방향으로 270도 게임판을 회전시킨다.
- * @param unsigned int board        게임판       
+ *                                  행마다 board[0][y] 에서 시작해 x 가 커지는 쪽으로 민다.
+ * @param Game game                 게임
+ * @param unsigned int n            게임판 크기
  * @return bool success             작업의 성공 여부
  */
-bool moveLeft(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE bool moveLeftN(Game *game, const unsigned int n)
 {
-    bool success;
-    rotateBoard(board);
-    success = moveUp(board);
-    rotateBoard(board);
-    rotateBoard(board);
-    rotateBoard(board);
+    bool success = false;
+    unsigned int y;
+    for (y = 0; y < n; y++) {
+        success |= slideLineN(game, y, MAX_SIZE, n);
+    }
     return success;
 }
 
 /**
  * @author                          이원준 (21jun7654@gmail.com)
- * @brief                           게임판의 블럭들을 왼쪽으로 이동하는 함수
- *                                  반 시계 벙향으로 180도 게임판을 회전시키고,
- *                                  moveUp 이후에 반 시계 방향으로 180도 게임판을 회전시킨다.
- * @param unsigned int board        게임판       
+ * @brief                           게임판의 블럭들을 아래로 이동하는 함수
+ *                                  열마다 board[x][n - 1] 에서 시작해 y 가 작아지는 쪽으로 민다.
+ * @param Game game                 게임
+ * @param unsigned int n            게임판 크기
  * @return bool success             작업의 성공 여부
  */
-bool moveDown(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE bool moveDownN(Game *game, const unsigned int n)
 {
-    bool success;
-    rotateBoard(board);
-    rotateBoard(board);
-    success = moveUp(board);
-    rotateBoard(board);
-    rotateBoard(board);
+    bool success = false;
+    unsigned int x;
+    for (x = 0; x < n; x++) {
+        success |= slideLineN(game, x * MAX_SIZE + n - 1, -1, n);
+    }
     return success;
 }
 
 /**
  * @author                          이원준 (21jun7654@gmail.com)
- * @brief                           게임판의 블럭들을 왼쪽으로 이동하는 함수
- *                                  반 시계 벙향으로 270도 게임판을 회전시키고,
- *                                  moveUp 이후에 반 시계 방향으로 90도 게임판을 회전시킨다.
- * @param unsigned int board        게임판       
+ * @brief                           게임판의 블럭들을 오른쪽으로 이동하는 함수
+ *                                  행마다 board[n - 1][y] 에서 시작해 x 가 작아지는 쪽으로 민다.
+ * @param Game game                 게임
+ * @param unsigned int n            게임판 크기
  * @return bool success             작업의 성공 여부
  */
-bool moveRight(unsigned int board[SIZE][SIZE])
-{
-    bool success;
-    rotateBoard(board);
-    rotateBoard(board);
-    rotateBoard(board);
-    success = moveUp(board);
-    rotateBoard(board);
-    return success;
-}
-
-bool findPairDown(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE bool moveRightN(Game *game, const unsigned int n)
 {
     bool success = false;
-    unsigned int x, y;
-    for (x = 0; x < SIZE; x++) {
-        for (y = 0; y < SIZE - 1; y++) {
-            if (board[x][y] == board[x][y + 1]) return true;
-        }
+    unsigned int y;
+    for (y = 0; y < n; y++) {
+        success |= slideLineN(game, (n - 1) * MAX_SIZE + y, -MAX_SIZE, n);
     }
     return success;
 }
 
-unsigned int countEmpty(unsigned int board[SIZE][SIZE])
+/**
+ * @brief                       게임판을 훑어서 game->empty 와 game->pairs 를 다시 계산한다.
+ * @param Game game             게임
+ * @param unsigned int n        게임판 크기
+ */
+static ALWAYS_INLINE void refreshMasksN(Game *game, const unsigned int n)
 {
+    unsigned int (*board)[MAX_SIZE] = game->board;
+    uint64_t empty = 0;
+    uint64_t pairs = 0;
     unsigned int x, y;
-    unsigned int count = 0;
-    for (x = 0; x < SIZE; x++) {
-        for (y = 0; y < SIZE; y++) {
-            if (board[x][y] == 0) {
-                count++;
+
+    for (x = 0; x < n; x++) {
+        for (y = 0; y < n; y++) {
+            empty |= (uint64_t) (board[x][y] == 0) << (8 * x + y);
+            if (y + 1 < n) {
+                pairs |= (uint64_t) (board[x][y + 1] == board[x][y]) << (8 * x + y);
+            }
+            if (x + 1 < n) {
+                pairs |= (uint64_t) (board[x + 1][y] == board[x][y]) << (8 * x + y);
             }
         }
     }
-    return count;
+    game->empty = empty;
+    game->pairs = pairs & ~empty;
 }
 
-bool gameEnded(unsigned int board[SIZE][SIZE])
-{
-    bool ended = true;
-    if (countEmpty(board) > 0) return false;
-    if (findPairDown(board)) return false;
-    rotateBoard(board);
-    if (findPairDown(board)) ended = false;
-    rotateBoard(board);
-    rotateBoard(board);
-    rotateBoard(board);
-    return ended;
-}
 /**
- * @author                      박소연 (pparksso0308@gmail.com)
- * @brief                       게임 시작시 모든 블록의 값을 각각 랜덤하게 설정
- * @param unsigned int board    화면에 출력할 게임판 정보
+ * @brief                       이동이 성공했으면 마스크를 갱신하고 그 결과를 그대로 돌려준다.
  */
-void addRandom(unsigned int board[SIZE][SIZE])
+static ALWAYS_INLINE bool movedN(Game *game, bool success, const unsigned int n)
 {
-    static bool initialized = false;
-    unsigned int x;
-    unsigned int y;
-    unsigned int r;
-    unsigned int len = 0;
-    unsigned int n;
-    unsigned int list[SIZE * SIZE][2];
-
-    if (!initialized) {
-        srand(time(NULL));
-        initialized = true; 
+    if (success) {
+        refreshMasksN(game, n);
     }
+    return success;
+}
 
-    for (x = 0; x < SIZE; x++) {
-        for (y = 0; y < SIZE; y++) {
-            if (board[x][y] == 0) { 
-                list[len][0] = x;
-                list[len][1] = y;
-                len++;
-            }
-        }
-    }
+/**
+ * @brief                       크기 N 에 특수화된 게임판 함수들과 그 테이블 kernelsN 을 만든다.
+ */
+#define DEFINE_KERNELS(N)                                                               \
+static bool slideArray##N(Game *game, unsigned int index)                               \
+{                                                                                       \
+    return slideArrayN(game, index, N);                                                 \
+}                                                                                       \
+static void rotateBoard##N(unsigned int board[MAX_SIZE][MAX_SIZE])                      \
+{                                                                                       \
+    rotateBoardN(board, N);                                                             \
+}                                                                                       \
+static bool moveUp##N(Game *game) { return movedN(game, moveUpN(game, N), N); }         \
+static bool moveDown##N(Game *game) { return movedN(game, moveDownN(game, N), N); }     \
+static bool moveLeft##N(Game *game) { return movedN(game, moveLeftN(game, N), N); }     \
+static bool moveRight##N(Game *game) { return movedN(game, moveRightN(game, N), N); }   \
+static void refreshMasks##N(Game *game) { refreshMasksN(game, N); }                     \
+static const Kernels kernels##N = {                                                     \
+    N, slideArray##N, rotateBoard##N,                                                   \
+    {moveUp##N, moveDown##N, moveLeft##N, moveRight##N},                                \
+    refreshMasks##N                                                                     \
+};
 
-    if (len > 0) {
-        r = rand() % len;
-        x = list[r][0];
-        y = list[r][1];
-        n = (rand() % 10) / 9 + 1;
-        board[x][y] = n;
-    }
-}
+DEFINE_KERNELS(3)
+DEFINE_KERNELS(4)
+DEFINE_KERNELS(5)
+DEFINE_KERNELS(6)
+DEFINE_KERNELS(7)
+DEFINE_KERNELS(8)
 
+static const Kernels *const boardKernels[MAX_SIZE + 1] = {
+    NULL, NULL, NULL, &kernels3, &kernels4, &kernels5, &kernels6, &kernels7, &kernels8
+};
 
 /**
- * @author        조유신 (cho8wola@sju.ac.kr)
- * @brief         게임보드를 초기화하는 함수, 2차원 배열을 0으로 초기화한 후 난수 2개를 입력
+ * @brief                       큰 게임판용 SIMD 이동 함수
+ * @remark                      칸 하나를 바이트 하나로 줄여서 한 줄 (최대 8칸) 을 64비트에 담고,
+ *                              128비트 레지스터 하나로 두 줄을 한꺼번에 처리한다.
+ *                              빈 칸을 건너뛰는 압축은 pshufb 와 256개짜리 셔플 테이블로,
+ *                              merge 는 이웃한 칸의 비교 마스크와 테이블로 계산하므로 한 줄을
+ *                              처리하는 비용이 칸 수와 상관없이 거의 일정하다.
+ *                              3x3 에서는 스칼라 함수가 더 빠르므로 VECTOR_MIN_SIZE 부터 사용한다.
+ *                              왼쪽/오른쪽은 8x8 바이트 전치, 아래/오른쪽은 바이트 뒤집기로
+ *                              위쪽 이동과 같은 모양으로 만든다.
+ *                              실행 중인 CPU 가 AVX2 를 지원하면 같은 코드를 VEX 인코딩으로,
+ *                              SSSE3 만 지원하면 SSE 로, 둘 다 없으면 DEFINE_KERNELS 의 스칼라 함수를 쓴다.
  */
-void initBoard(unsigned int board[SIZE][SIZE])
-{
-    unsigned int x, y;
-    for (x = 0; x < SIZE; x++) {
-        for (y = 0; y < SIZE; y++) {
-            board[x][y] = 0;
+#define VECTOR_MIN_SIZE              4
+
+static Kernels vectorKernels[MAX_SIZE + 1];
+
+#ifdef VECTOR_MOVES
+
+#define VECTOR_TARGET                __attribute__((target("ssse3")))
+
+static uint64_t compressTable[256];
+static uint64_t byteMaskTable[256];
+static uint8_t mergeTable[256];
+static uint8_t reverseControl[MAX_SIZE + 1][16];
+static uint8_t lineMask[MAX_SIZE + 1][16];
+static uint32_t tailMask[MAX_SIZE + 1][MAX_SIZE];
+
+/**
+ * @brief                       SIMD 이동에 사용하는 테이블을 만든다.
+ * @remark                      compressTable[m] 은 m 의 비트가 켜진 바이트들을 앞으로 모으는 pshufb 제어값,
+ *                              mergeTable[e] 는 이웃한 두 칸이 같은 위치 e 에서 왼쪽부터 merge 되는 위치,
+ *                              byteMaskTable[m] 은 m 의 비트마다 0xFF 인 바이트 마스크이다.
+ */
+static void initVectorTables(void)
+{
+    unsigned int m, i, n, count;
+    uint64_t control;
+
+    for (m = 0; m < 256; m++) {
+        control = 0x8080808080808080ULL;
+        count = 0;
+        for (i = 0; i < 8; i++) {
+            if (m & (1u << i)) {
+                control &= ~(0xFFULL << (8 * count));
+                control |= (uint64_t) i << (8 * count);
+                count++;
+                byteMaskTable[m] |= 0xFFULL << (8 * i);
+            }
+        }
+        compressTable[m] = control;
+        for (i = 0; i < 7; i++) {
+            if (m & (1u << i)) {
+                // the pair is merged, its second tile cannot start another pair
+                mergeTable[m] |= 1u << i;
+                i++;
+            }
+        }
+    }
+    for (n = 0; n <= MAX_SIZE; n++) {
+        for (i = 0; i < 16; i++) {
+            reverseControl[n][i] = i % 8 < n ? (i & 8) + n - 1 - i % 8 : i;
+            lineMask[n][i] = i % 8 < n ? 0xFF : 0;
+        }
+        for (i = 0; i < MAX_SIZE; i++) {
+            tailMask[n][i] = i < n ? 0 : 0xFFFFFFFFu;
+        }
+    }
+}
+
+/**
+ * @brief                       두 줄을 담은 레지스터에서 0 이 아닌 바이트들을 각 줄의 앞으로 모은다.
+ */
+static ALWAYS_INLINE VECTOR_TARGET __m128i compressLines(__m128i v)
+{
+    unsigned int m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) & 0xFFFF;
+    __m128i control = _mm_set_epi64x(compressTable[m >> 8] | 0x0808080808080808ULL, compressTable[m & 0xFF]);
+    return _mm_shuffle_epi8(v, control);
+}
+
+/**
+ * @brief                       두 줄을 index 0 쪽으로 밀고 merge 한다. (slideArray 와 같은 규칙)
+ * @param __m128i v             바이트 하나에 칸 하나, 아래 8바이트와 위 8바이트가 각각 한 줄
+ * @param unsigned int score    merge 로 얻은 점수를 더할 변수
+ */
+static ALWAYS_INLINE VECTOR_TARGET __m128i slideLines(__m128i v, unsigned int *score)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i c = compressLines(v);
+    // bit i: byte i is a tile and equal to the next byte of the same line
+    __m128i same = _mm_andnot_si128(_mm_cmpeq_epi8(c, zero), _mm_cmpeq_epi8(c, _mm_srli_epi64(c, 8)));
+    unsigned int pairs = _mm_movemask_epi8(same);
+    unsigned int heads = mergeTable[pairs & 0xFF] | (unsigned int) mergeTable[pairs >> 8] << 8;
+    uint8_t bytes[16];
+    unsigned int m;
+
+    if (heads == 0) {
+        return c;
+    }
+    _mm_storeu_si128((__m128i *) bytes, c);
+    for (m = heads; m != 0; m &= m - 1) {
+        *score += (unsigned int) 1 << (bytes[__builtin_ctz(m)] + 1);
+        STAT_MERGE(bytes[__builtin_ctz(m)] + 1);
+    }
+    // merge heads grow by one, the tile after each head is consumed
+    c = _mm_add_epi8(c, _mm_and_si128(_mm_set1_epi8(1),
+                                      _mm_set_epi64x(byteMaskTable[heads >> 8], byteMaskTable[heads & 0xFF])));
+    c = _mm_andnot_si128(_mm_set_epi64x(byteMaskTable[(heads >> 7) & 0xFF], byteMaskTable[(heads << 1) & 0xFF]), c);
+    return compressLines(c);
+}
+
+/**
+ * @brief                       두 줄씩 담은 레지스터 네 개로 표현한 8x8 바이트 행렬을 전치한다.
+ */
+static ALWAYS_INLINE VECTOR_TARGET void transposeLines(__m128i lines[MAX_SIZE / 2])
+{
+    __m128i a0 = _mm_unpacklo_epi8(lines[0], _mm_srli_si128(lines[0], 8));
+    __m128i a1 = _mm_unpacklo_epi8(lines[1], _mm_srli_si128(lines[1], 8));
+    __m128i a2 = _mm_unpacklo_epi8(lines[2], _mm_srli_si128(lines[2], 8));
+    __m128i a3 = _mm_unpacklo_epi8(lines[3], _mm_srli_si128(lines[3], 8));
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+    __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+
+    lines[0] = _mm_unpacklo_epi32(b0, b2);
+    lines[1] = _mm_unpackhi_epi32(b0, b2);
+    lines[2] = _mm_unpacklo_epi32(b1, b3);
+    lines[3] = _mm_unpackhi_epi32(b1, b3);
+}
+
+/**
+ * @brief                       board[x] 한 줄의 칸들을 16비트 8개로 줄인다.
+ */
+static ALWAYS_INLINE VECTOR_TARGET __m128i loadLine(const unsigned int line[MAX_SIZE])
+{
+    return _mm_packs_epi32(_mm_loadu_si128((const __m128i *) line), _mm_loadu_si128((const __m128i *) (line + 4)));
+}
+
+/**
+ * @brief                       바이트 8개를 board[x] 한 줄에 저장한다. size 밖의 칸은 그대로 둔다.
+ */
+static ALWAYS_INLINE VECTOR_TARGET void storeLine(unsigned int line[MAX_SIZE], __m128i bytes, unsigned int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    __m128i low = _mm_loadu_si128((const __m128i *) line);
+    __m128i high = _mm_loadu_si128((const __m128i *) (line + 4));
+
+    low = _mm_or_si128(_mm_unpacklo_epi16(words, zero),
+                       _mm_and_si128(low, _mm_loadu_si128((const __m128i *) tailMask[n])));
+    high = _mm_or_si128(_mm_unpackhi_epi16(words, zero),
+                        _mm_and_si128(high, _mm_loadu_si128((const __m128i *) (tailMask[n] + 4))));
+    _mm_storeu_si128((__m128i *) line, low);
+    _mm_storeu_si128((__m128i *) (line + 4), high);
+}
+
+/**
+ * @brief                       열 두 개씩 담은 레지스터들에서 game->empty 와 game->pairs 를 계산한다.
+ * @remark                      아래 칸과의 비교는 64비트 안에서 한 바이트 민 값과, 오른쪽 칸과의 비교는
+ *                              위 8바이트와 다음 레지스터의 아래 8바이트를 이어 붙인 값과 비교한다.
+ */
+static ALWAYS_INLINE VECTOR_TARGET void lineMasks(Game *game, const __m128i lines[MAX_SIZE / 2], unsigned int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t empty = 0;
+    uint64_t down = 0;
+    uint64_t right = 0;
+    __m128i next;
+    unsigned int r;
+
+    for (r = 0; 2 * r < n; r++) {
+        next = 2 * r + 2 < n ? _mm_slli_si128(lines[r + 1], 8) : zero;
+        empty |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lines[r], zero)) << (16 * r);
+        down |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lines[r], _mm_srli_epi64(lines[r], 8))) << (16 * r);
+        right |= (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lines[r], _mm_or_si128(_mm_srli_si128(lines[r], 8), next)))
+                 << (16 * r);
+    }
+    game->empty = empty & boardMask(n, n);
+    game->pairs = ~empty & ((down & boardMask(n, n - 1)) | (right & boardMask(n - 1, n)));
+}
+
+/**
+ * @brief                       게임판 전체를 한 방향으로 이동한다.
+ * @param Game game             게임, 크기는 VECTOR_MIN_SIZE 이상
+ * @param unsigned int direction MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ * @return bool                 하나의 블럭이라도 이동했다면 true
+ */
+static ALWAYS_INLINE VECTOR_TARGET bool vectorMove(Game *game, unsigned int direction)
+{
+    const unsigned int n = game->size;
+    const __m128i mask = _mm_loadu_si128((const __m128i *) lineMask[n]);
+    const __m128i reverse = _mm_loadu_si128((const __m128i *) reverseControl[n]);
+    const bool across = direction == MOVE_LEFT || direction == MOVE_RIGHT;
+    const bool backward = direction == MOVE_DOWN || direction == MOVE_RIGHT;
+    __m128i lines[MAX_SIZE / 2];
+    __m128i moved;
+    unsigned int score = 0;
+    unsigned int changed = 0;
+    unsigned int r, x;
+
+    for (r = 0; r < MAX_SIZE / 2; r++) {
+        x = 2 * r;
+        lines[r] = _mm_and_si128(mask, _mm_packus_epi16(x < n ? loadLine(game->board[x]) : _mm_setzero_si128(),
+                                                        x + 1 < n ? loadLine(game->board[x + 1]) : _mm_setzero_si128()));
+    }
+    if (across) {
+        transposeLines(lines);
+    }
+    STAT_ADD(lines, n);
+    for (r = 0; 2 * r < n; r++) {
+        if (backward) {
+            lines[r] = _mm_shuffle_epi8(lines[r], reverse);
+        }
+        moved = slideLines(lines[r], &score);
+        changed |= _mm_movemask_epi8(_mm_cmpeq_epi8(moved, lines[r])) ^ 0xFFFF;
+        lines[r] = backward ? _mm_shuffle_epi8(moved, reverse) : moved;
+    }
+    if (changed == 0) {
+        return false;
+    }
+    if (across) {
+        transposeLines(lines);
+    }
+    for (x = 0; x < n; x++) {
+        storeLine(game->board[x], x % 2 == 0 ? lines[x / 2] : _mm_srli_si128(lines[x / 2], 8), n);
+    }
+    lineMasks(game, lines, n);
+    game->score += score;
+    return true;
+}
+
+/**
+ * @brief                       TARGET 으로 컴파일한 vectorMove 를 방향마다 하나씩 만든다.
+ */
+#define DEFINE_VECTOR_MOVES(SUFFIX, TARGET)                                                     \
+__attribute__((target(TARGET))) static bool vectorMoveUp##SUFFIX(Game *game)                    \
+{                                                                                               \
+    return vectorMove(game, MOVE_UP);                                                           \
+}                                                                                               \
+__attribute__((target(TARGET))) static bool vectorMoveDown##SUFFIX(Game *game)                  \
+{                                                                                               \
+    return vectorMove(game, MOVE_DOWN);                                                         \
+}                                                                                               \
+__attribute__((target(TARGET))) static bool vectorMoveLeft##SUFFIX(Game *game)                  \
+{                                                                                               \
+    return vectorMove(game, MOVE_LEFT);                                                         \
+}                                                                                               \
+__attribute__((target(TARGET))) static bool vectorMoveRight##SUFFIX(Game *game)                 \
+{                                                                                               \
+    return vectorMove(game, MOVE_RIGHT);                                                        \
+}
+
+DEFINE_VECTOR_MOVES(Ssse3, "ssse3")
+DEFINE_VECTOR_MOVES(Avx2, "avx2")
+
+#endif
+
+/**
+ * @brief                       실행 중인 CPU 에서 쓸 수 있는 가장 넓은 SIMD 이동 함수로 vectorKernels 를 채운다.
+ * @remark                      지원하지 않으면 vectorKernels 는 비어 있고 setBoardSize 는 스칼라 함수를 고른다.
+ *                              selectBit 도 여기서 BMI2 지원 여부에 맞게 고른다.
+ * @return const char           고른 명령어 집합 이름
+ */
+const char *initVectorKernels(void)
+{
+    static const char *name = NULL;
+    bool (*moves[MOVE_COUNT])(Game *) = {NULL, NULL, NULL, NULL};
+    unsigned int n, d;
+
+    if (name != NULL) {
+        return name;
+    }
+    name = "scalar";
+#ifdef VECTOR_MOVES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        bool (*avx2[])(Game *) = {vectorMoveUpAvx2, vectorMoveDownAvx2, vectorMoveLeftAvx2, vectorMoveRightAvx2};
+        memcpy(moves, avx2, sizeof(moves));
+        name = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        bool (*ssse3[])(Game *) = {vectorMoveUpSsse3, vectorMoveDownSsse3, vectorMoveLeftSsse3, vectorMoveRightSsse3};
+        memcpy(moves, ssse3, sizeof(moves));
+        name = "ssse3";
+    }
+    if (moves[0] != NULL) {
+        initVectorTables();
+    }
+    // PDEP is microcoded and slower than the portable select before Zen 3
+    if (__builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2")) {
+        selectKernel = selectBitBmi2;
+    }
+#endif
+    for (n = VECTOR_MIN_SIZE; moves[0] != NULL && n <= MAX_SIZE; n++) {
+        vectorKernels[n] = *boardKernels[n];
+        for (d = 0; d < MOVE_COUNT; d++) {
+            vectorKernels[n].move[d] = moves[d];
+        }
+    }
+    return name;
+}
+
+
+/**
+ * @brief                       게임판 크기를 바꾸고 그 크기에 특수화된 함수들을 고른다.
+ * @remark                      게임판 내용은 그대로 두므로 보통 initBoard 를 이어서 호출한다.
+ * @param Game game             게임
+ * @param unsigned int size     MIN_SIZE 이상 MAX_SIZE 이하의 크기
+ * @return bool                 지원하지 않는 크기이면 false
+ */
+bool setBoardSize(Game *game, unsigned int size)
+{
+    if (size < MIN_SIZE || size > MAX_SIZE) {
+        return false;
+    }
+    initVectorKernels();
+    game->size = size;
+    game->kernels = vectorKernels[size].size != 0 ? &vectorKernels[size] : boardKernels[size];
+    return true;
+}
+
+/**
+ * @brief                       아래 함수들은 게임판 크기에 맞는 특수화된 함수를 호출한다.
+ */
+bool slideArray(Game *game, unsigned int index)
+{
+    bool success = game->kernels->slideArray(game, index);
+    game->kernels->refreshMasks(game);
+    return success;
+}
+
+void rotateBoard(Game *game)
+{
+    game->kernels->rotateBoard(game->board);
+    game->kernels->refreshMasks(game);
+}
+
+bool moveUp(Game *game)
+{
+    return game->kernels->move[MOVE_UP](game);
+}
+
+bool moveDown(Game *game)
+{
+    return game->kernels->move[MOVE_DOWN](game);
+}
+
+bool moveLeft(Game *game)
+{
+    return game->kernels->move[MOVE_LEFT](game);
+}
+
+bool moveRight(Game *game)
+{
+    return game->kernels->move[MOVE_RIGHT](game);
+}
+
+void refreshMasks(Game *game)
+{
+    game->kernels->refreshMasks(game);
+}
+
+unsigned int countEmpty(Game *game)
+{
+    return __builtin_popcountll(game->empty);
+}
+
+/**
+ * @brief                       빈 칸도 없고 이웃한 같은 블럭도 없으면 게임이 끝난 것이다.
+ * @remark                      두 마스크만 보므로 게임판을 읽거나 바꾸지 않는다.
+ */
+bool gameEnded(Game *game)
+{
+    return (game->empty | game->pairs) == 0;
+}
+
+/**
+ * @author                      박소연 (pparksso0308@gmail.com)
+ * @brief                       게임판의 빈 칸 하나에 2 또는 4 를 랜덤하게 추가
+ * @remark                      빈 칸 마스크에서 k 번째 비트를 selectBit 로 바로 찾으므로 게임판을 훑지 않고,
+ *                              새 블럭과 네 이웃만 비교해서 두 마스크를 갱신한다.
+ *                              빈 칸을 board[0][0], board[0][1], ... 순서로 세므로 예전과 같은 난수열에서
+ *                              같은 위치에 같은 값이 생긴다.
+ * @param Game game             게임, game->rng 의 난수 상태를 사용한다.
+ */
+void addRandom(Game *game)
+{
+    const unsigned int n = game->size;
+    unsigned int (*board)[MAX_SIZE] = game->board;
+    unsigned int len = __builtin_popcountll(game->empty);
+    unsigned int bit, x, y, value;
+    uint64_t pairs;
+
+    STAT_ADD(spawns, 1);
+    if (len == 0) {
+        return;
+    }
+    bit = selectBit(game->empty, randomBelow(&game->rng, len));
+    value = randomBelow(&game->rng, 10) / 9 + 1;
+    x = bit / 8;
+    y = bit % 8;
+    board[x][y] = value;
+    // the new tile pairs with an equal neighbour below or right, the one above or left with it;
+    // edge cells compare with themselves and are masked out, which keeps this free of branches
+    pairs = (uint64_t) (((y + 1 < n) & (board[x][y + (y + 1 < n)] == value))
+                        | ((x + 1 < n) & (board[x + (x + 1 < n)][y] == value))) << bit
+            | ((uint64_t) ((y > 0) & (board[x][y - (y > 0)] == value)) << bit >> 1)
+            | ((uint64_t) ((x > 0) & (board[x - (x > 0)][y] == value)) << bit >> 8);
+    game->empty &= ~((uint64_t) 1 << bit);
+    game->pairs |= pairs;
+}
+
+/**
+ * @brief                       4x4 게임판을 64비트 정수 하나로 표현한 타입 (칸 하나당 4비트)
+ * @remark                      board[x][y] 의 지수는 (4 * x + y) 번째 nibble 에 저장된다.
+ *                              즉 한 열(column)이 16비트 하나에 들어가므로 moveUp/moveDown 은
+ *                              16비트 단위 테이블 조회 4번으로 끝나고, moveLeft/moveRight 는
+ *                              전치(transpose) 후 같은 테이블을 사용한다.
+ *                              지수가 15 (32768) 를 넘는 타일은 표현할 수 없으므로 15 로 포화된다.
+ */
+typedef uint64_t board_t;
+
+#define ROW_COUNT       65536
+#define ROW_MASK        0xFFFFULL
+
+static uint16_t rowUpTable[ROW_COUNT];
+static uint16_t rowDownTable[ROW_COUNT];
+static uint32_t rowScoreTable[ROW_COUNT];
+static uint16_t rowMergeTable[ROW_COUNT];
+
+static uint16_t reverseRow(uint16_t row)
+{
+    return (uint16_t) ((row >> 12) | ((row >> 4) & 0x00F0) | ((row << 4) & 0x0F00) | (row << 12));
+}
+
+void initBatchKernels(void);
+
+/**
+ * @brief                       이동 전후의 지수별 블럭 수 차이로 merge 로 만들어진 지수별 블럭 수를 구한다.
+ * @remark                      merge 하나는 지수 e - 1 블럭 두 개를 e 블럭 하나로 바꾸므로 높은 지수부터 풀면 된다.
+ * @param int change            지수별 (이동 후 블럭 수 - 이동 전 블럭 수)
+ * @param unsigned int merges   지수별 merge 수를 더할 배열
+ */
+void countMerges(const int change[TILE_LEVELS], unsigned int merges[TILE_LEVELS])
+{
+    int made = 0;
+    unsigned int e;
+
+    for (e = TILE_LEVELS - 1; e > 0; e--) {
+        made = change[e] + 2 * made;
+        merges[e] += made;
+    }
+}
+
+/**
+ * @brief                       16비트 행(4칸) 전체에 대한 이동 결과와 획득 점수 테이블을 만든다.
+ * @remark                      결과는 slideArray (findTarget 기준 구현) 를 그대로 실행해서 얻으므로 stop 에 의한
+ *                              중복 merge 방지 규칙과 점수 계산이 기존 구현과 완전히 같다.
+ *                              merge 테이블은 merge 로 만들어진 블럭의 지수를 한 바이트씩 (최대 두 개) 담는다.
+ *                              merge 는 같은 블럭이 이어진 구간마다 둘씩 묶이므로 방향과 상관없이 같다.
+ *                              packed 함수들을 사용하기 전에 한 번 호출해야 한다.
+ */
+void initZobrist(void);
+
+void initMoveTables(void)
+{
+    static bool initialized = false;
+    Game game;
+    unsigned int row, result, value, i, e, k;
+    unsigned int merges[TILE_LEVELS];
+    int change[TILE_LEVELS];
+#ifdef STATS
+    // building the tables is not part of any game, so it is left out of the --stats counters
+    Stats saved = threadStats;
+#endif
+
+    if (initialized) {
+        return;
+    }
+    memset(game.board, 0, sizeof(game.board));
+    setBoardSize(&game, SIZE);
+    for (row = 0; row < ROW_COUNT; row++) {
+        memset(change, 0, sizeof(change));
+        memset(merges, 0, sizeof(merges));
+        for (i = 0; i < SIZE; i++) {
+            game.board[0][i] = (row >> (4 * i)) & 0xF;
+            change[game.board[0][i]]--;
+        }
+        game.score = 0;
+        slideArray(&game, 0);
+
+        result = 0;
+        for (i = 0; i < SIZE; i++) {
+            change[game.board[0][i]]++;
+        }
+        countMerges(change, merges);
+        rowMergeTable[row] = 0;
+        for (e = 1, k = 0; e < TILE_LEVELS; e++) {
+            for (; merges[e] > 0; merges[e]--, k++) {
+                rowMergeTable[row] |= e << (8 * k);
+            }
+        }
+        for (i = 0; i < SIZE; i++) {
+            value = game.board[0][i];
+            // a 65536 tile does not fit in a nibble
+            if (value > 15) {
+                value = 15;
+            }
+            result |= value << (4 * i);
+        }
+        rowUpTable[row] = (uint16_t) result;
+        rowScoreTable[row] = game.score;
+        rowDownTable[reverseRow((uint16_t) row)] = reverseRow((uint16_t) result);
+    }
+    initBatchKernels();
+    initZobrist();
+#ifdef STATS
+    threadStats = saved;
+#endif
+    initialized = true;
+}
+
+/**
+ * @brief                       배열 게임판을 board_t 로 변환한다.
+ * @param unsigned int board    게임판
+ * @return board_t              변환된 게임판
+ */
+board_t packBoard(unsigned int board[MAX_SIZE][MAX_SIZE])
+{
+    board_t packed = 0;
+    unsigned int x, y, value;
+    for (x = 0; x < SIZE; x++) {
+        for (y = 0; y < SIZE; y++) {
+            value = board[x][y] > 15 ? 15 : board[x][y];
+            packed |= (board_t) value << (4 * (SIZE * x + y));
+        }
+    }
+    return packed;
+}
+
+/**
+ * @brief                       board_t 를 배열 게임판으로 변환한다.
+ * @param board_t packed        변환할 게임판
+ * @param unsigned int board    결과를 저장할 게임판
+ */
+void unpackBoard(board_t packed, unsigned int board[MAX_SIZE][MAX_SIZE])
+{
+    unsigned int x, y;
+    for (x = 0; x < SIZE; x++) {
+        for (y = 0; y < SIZE; y++) {
+            board[x][y] = (packed >> (4 * (SIZE * x + y))) & 0xF;
+        }
+    }
+}
+
+/**
+ * @brief                       board_t 의 행과 열을 바꾼다. (board[x][y] <-> board[y][x])
+ */
+board_t transposeBoard(board_t b)
+{
+    board_t a1 = b & 0xF0F00F0FF0F00F0FULL;
+    board_t a2 = b & 0x0000F0F00000F0F0ULL;
+    board_t a3 = b & 0x0F0F00000F0F0000ULL;
+    board_t a = a1 | (a2 << 12) | (a3 >> 12);
+    board_t b1 = a & 0xFF00FF0000FF00FFULL;
+    board_t b2 = a & 0x00FF00FF00000000ULL;
+    board_t b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+static board_t applyRows(board_t b, const uint16_t *table, unsigned int *gained)
+{
+    board_t result = 0;
+    unsigned int i;
+    uint16_t row;
+    for (i = 0; i < SIZE; i++) {
+        row = (uint16_t) ((b >> (16 * i)) & ROW_MASK);
+        result |= (board_t) table[row] << (16 * i);
+        *gained += rowScoreTable[row];
+    }
+    return result;
+}
+
+/**
+ * @brief                       board_t 게임판의 블럭들을 위로 이동하는 함수
+ * @param board_t b             게임판
+ * @param unsigned int gained   merge 로 얻은 점수를 더할 변수
+ * @return board_t              이동한 결과, 이동할 수 없으면 b 와 같은 값
+ */
+board_t packedMoveUp(board_t b, unsigned int *gained)
+{
+    return applyRows(b, rowUpTable, gained);
+}
+
+board_t packedMoveDown(board_t b, unsigned int *gained)
+{
+    return applyRows(b, rowDownTable, gained);
+}
+
+board_t packedMoveLeft(board_t b, unsigned int *gained)
+{
+    return transposeBoard(applyRows(transposeBoard(b), rowUpTable, gained));
+}
+
+board_t packedMoveRight(board_t b, unsigned int *gained)
+{
+    return transposeBoard(applyRows(transposeBoard(b), rowDownTable, gained));
+}
+
+/**
+ * @brief                       값이 0 인 nibble 마다 그 nibble 의 가장 높은 비트 (0x8) 를 켠 값
+ */
+static ALWAYS_INLINE board_t zeroNibbles(board_t v)
+{
+    board_t t = (v & 0x7777777777777777ULL) + 0x7777777777777777ULL;
+    return ~(t | v | 0x7777777777777777ULL);
+}
+
+unsigned int packedCountEmpty(board_t b)
+{
+    return __builtin_popcountll(zeroNibbles(b));
+}
+
+/**
+ * @brief                       방향 상수에 해당하는 packed 이동 함수를 호출한다.
+ * @param board_t b             게임판
+ * @param unsigned int direction MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ * @param unsigned int gained   merge 로 얻은 점수를 더할 변수
+ * @return board_t              이동한 결과
+ */
+board_t packedMove(board_t b, unsigned int direction, unsigned int *gained)
+{
+    switch (direction) {
+        case MOVE_UP:
+            return packedMoveUp(b, gained);
+        case MOVE_DOWN:
+            return packedMoveDown(b, gained);
+        case MOVE_LEFT:
+            return packedMoveLeft(b, gained);
+        case MOVE_RIGHT:
+            return packedMoveRight(b, gained);
+    }
+    return b;
+}
+
+unsigned int packedMaxTile(board_t b)
+{
+    unsigned int max = 0;
+    unsigned int i, value;
+    for (i = 0; i < SIZE * SIZE; i++) {
+        value = (b >> (4 * i)) & 0xF;
+        if (value > max) {
+            max = value;
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief                       board_t 게임판의 빈 칸 하나에 2 또는 4 를 추가한다.
+ * @remark                      빈 칸을 addRandom 과 같은 순서로 세므로 같은 난수열에서는
+ *                              addRandom 과 같은 위치에 같은 값이 생긴다.
+ * @param board_t b             게임판
+ * @param uint64_t rng          난수 상태
+ * @return board_t              블럭이 추가된 게임판, 빈 칸이 없으면 b
+ */
+board_t packedAddRandom(board_t b, uint64_t *rng)
+{
+    board_t empty = zeroNibbles(b);
+    unsigned int len = __builtin_popcountll(empty);
+    unsigned int r;
+    board_t n;
+
+    if (len == 0) {
+        return b;
+    }
+    r = randomBelow(rng, len);
+    n = randomBelow(rng, 10) / 9 + 1;
+    // the empty bit is the highest of its nibble
+    return b | n << (selectBit(empty, r) - 3);
+}
+
+/**
+ * @brief 게임판 대칭 변환 상수입니다
+ * @remark 변환 번호의 비트마다 전치, 열 안에서 뒤집기 (y), 열 순서 뒤집기 (x) 를 이 순서로 적용하므로
+ *         0 ~ 7 이 회전과 뒤집기로 만들 수 있는 8가지 대칭을 모두 나타낸다.
+ */
+#define SYMMETRY_MIRROR              1
+#define SYMMETRY_FLIP                2
+#define SYMMETRY_TRANSPOSE           4
+#define SYMMETRY_COUNT               8
+
+/**
+ * @brief                       칸과 지수마다 하나씩 정한 Zobrist 난수, 빈 칸 (지수 0) 은 0 이다.
+ * @remark                      zobristRows[x][column] 은 x 번째 열이 column 일 때 네 칸의 난수를 XOR 한 값이므로
+ *                              게임판 전체의 해시는 표 조회 4번이다.
+ */
+static uint64_t zobristCells[SIZE * SIZE][16];
+static uint64_t zobristRows[SIZE][ROW_COUNT];
+
+void initZobrist(void)
+{
+    uint64_t rng = seedRandom(2048, 0);
+    unsigned int cell, value, x, row;
+
+    for (cell = 0; cell < SIZE * SIZE; cell++) {
+        zobristCells[cell][0] = 0;
+        for (value = 1; value < 16; value++) {
+            zobristCells[cell][value] = nextRandom64(&rng);
+        }
+    }
+    for (x = 0; x < SIZE; x++) {
+        for (row = 0; row < ROW_COUNT; row++) {
+            zobristRows[x][row] = zobristCells[SIZE * x][row & 0xF] ^ zobristCells[SIZE * x + 1][(row >> 4) & 0xF]
+                                  ^ zobristCells[SIZE * x + 2][(row >> 8) & 0xF] ^ zobristCells[SIZE * x + 3][row >> 12];
+        }
+    }
+}
+
+/**
+ * @brief                       board_t 게임판의 Zobrist 해시 (initMoveTables 이후에 사용)
+ */
+uint64_t boardHash(board_t b)
+{
+    return zobristRows[0][b & ROW_MASK] ^ zobristRows[1][(b >> 16) & ROW_MASK]
+           ^ zobristRows[2][(b >> 32) & ROW_MASK] ^ zobristRows[3][b >> 48];
+}
+
+/**
+ * @brief                       이동 전 게임판의 해시를 이동 후 게임판의 해시로 바꾼다.
+ * @remark                      바뀐 열만 다시 계산하므로 게임판 전체를 해시하지 않는다.
+ * @param uint64_t hash         before 의 해시
+ * @return uint64_t             after 의 해시
+ */
+uint64_t hashMove(uint64_t hash, board_t before, board_t after)
+{
+    board_t changed = before ^ after;
+    unsigned int x;
+
+    for (x = 0; x < SIZE; x++) {
+        if ((changed >> (16 * x)) & ROW_MASK) {
+            hash ^= zobristRows[x][(before >> (16 * x)) & ROW_MASK] ^ zobristRows[x][(after >> (16 * x)) & ROW_MASK];
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief                       빈 칸 cell 에 지수 value 인 블럭이 생긴 게임판의 해시
+ * @param unsigned int cell     칸 번호 (SIZE * x + y)
+ */
+uint64_t hashSpawn(uint64_t hash, unsigned int cell, unsigned int value)
+{
+    return hash ^ zobristCells[cell][value];
+}
+
+/**
+ * @brief                       각 열 안의 칸 순서를 뒤집는다. (board[x][y] <-> board[x][3 - y])
+ */
+static ALWAYS_INLINE board_t mirrorBoard(board_t b)
+{
+    return ((b & 0x000F000F000F000FULL) << 12) | ((b & 0x00F000F000F000F0ULL) << 4)
+           | ((b >> 4) & 0x00F000F000F000F0ULL) | ((b >> 12) & 0x000F000F000F000FULL);
+}
+
+/**
+ * @brief                       열의 순서를 뒤집는다. (board[x][y] <-> board[3 - x][y])
+ */
+static ALWAYS_INLINE board_t flipBoard(board_t b)
+{
+    return (b << 48) | ((b << 16) & 0x0000FFFF00000000ULL) | ((b >> 16) & 0x00000000FFFF0000ULL) | (b >> 48);
+}
+
+/**
+ * @brief                       게임판에 대칭 변환 하나를 적용한다.
+ * @param unsigned int transform 0 ~ SYMMETRY_COUNT - 1 (SYMMETRY_MIRROR 참고)
+ */
+board_t applySymmetry(board_t b, unsigned int transform)
+{
+    if (transform & SYMMETRY_TRANSPOSE) {
+        b = transposeBoard(b);
+    }
+    if (transform & SYMMETRY_MIRROR) {
+        b = mirrorBoard(b);
+    }
+    if (transform & SYMMETRY_FLIP) {
+        b = flipBoard(b);
+    }
+    return b;
+}
+
+/**
+ * @brief                       applySymmetry 를 되돌린다.
+ */
+board_t invertSymmetry(board_t b, unsigned int transform)
+{
+    if (transform & SYMMETRY_FLIP) {
+        b = flipBoard(b);
+    }
+    if (transform & SYMMETRY_MIRROR) {
+        b = mirrorBoard(b);
+    }
+    if (transform & SYMMETRY_TRANSPOSE) {
+        b = transposeBoard(b);
+    }
+    return b;
+}
+
+/**
+ * @brief                       원래 게임판에서의 이동 방향을 변환한 게임판에서의 방향으로 바꾼다.
+ * @remark                      packedMove(applySymmetry(b, t), symmetryDirection(d, t))
+ *                              == applySymmetry(packedMove(b, d), t)
+ */
+unsigned int symmetryDirection(unsigned int direction, unsigned int transform)
+{
+    if (transform & SYMMETRY_TRANSPOSE) {
+        // up <-> left, down <-> right
+        direction ^= 2;
+    }
+    if ((transform & SYMMETRY_MIRROR) && direction < MOVE_LEFT) {
+        direction ^= 1;
+    }
+    if ((transform & SYMMETRY_FLIP) && direction >= MOVE_LEFT) {
+        direction ^= 1;
+    }
+    return direction;
+}
+
+/**
+ * @brief                       8가지 대칭 중 값이 가장 작은 게임판 (대표 게임판) 을 구한다.
+ * @remark                      대칭인 게임판들은 같은 대표 게임판을 가지므로 캐시나 transposition table 의
+ *                              키로 쓰면 같은 상태를 한 번만 저장한다.
+ * @param board_t b             게임판
+ * @param unsigned int transform NULL 이 아니면 b 를 대표 게임판으로 바꾸는 변환을 저장한다.
+ * @return board_t              대표 게임판, applySymmetry(b, *transform) 과 같다.
+ */
+board_t canonicalBoard(board_t b, unsigned int *transform)
+{
+    board_t t = transposeBoard(b);
+    board_t candidates[SYMMETRY_COUNT];
+    board_t best;
+    unsigned int i, chosen = 0;
+
+    candidates[0] = b;
+    candidates[SYMMETRY_TRANSPOSE] = t;
+    for (i = 0; i < SYMMETRY_COUNT; i += SYMMETRY_TRANSPOSE) {
+        candidates[i + SYMMETRY_MIRROR] = mirrorBoard(candidates[i]);
+        candidates[i + SYMMETRY_FLIP] = flipBoard(candidates[i]);
+        candidates[i + SYMMETRY_MIRROR + SYMMETRY_FLIP] = flipBoard(candidates[i + SYMMETRY_MIRROR]);
+    }
+    best = candidates[0];
+    for (i = 1; i < SYMMETRY_COUNT; i++) {
+        if (candidates[i] < best) {
+            best = candidates[i];
+            chosen = i;
+        }
+    }
+    if (transform != NULL) {
+        *transform = chosen;
+    }
+    return best;
+}
+
+/**
+ * @brief                       여러 board_t 게임을 게임마다 구조체 하나 대신 필드마다 배열 하나로 담은 묶음
+ * @remark                      batchMove, batchAddRandom, batchGameEnded 는 묶음 전체를 한 번에 진행하고
+ *                              결과를 게임당 1비트인 마스크 (uint64_t 하나에 64게임) 로 돌려준다.
+ *                              같은 종류의 값이 연속해 있으므로 전치, 비교 같은 단계는 컴파일러가
+ *                              여러 게임을 한 번에 처리하는 벡터 코드로 만들 수 있다.
+ * @param count                 게임 수
+ * @param boards                게임판들
+ * @param scores                점수들, batchMove 가 merge 로 얻은 점수를 더한다.
+ * @param rngs                  게임마다 새 블럭에 사용하는 난수 상태들
+ */
+typedef struct {
+    size_t count;
+    board_t *boards;
+    unsigned int *scores;
+    uint64_t *rngs;
+} BoardBatch;
+
+#define BATCH_BLOCK                  64
+#define BATCH_WORDS(count)           (((count) + BATCH_BLOCK - 1) / BATCH_BLOCK)
+
+/**
+ * @brief                       움직일 수 있는 곳이 있는 게임판이면 0 이 아닌 값
+ * @remark                      빈 칸, 세로로 (y) 이웃한 같은 칸, 가로로 (x) 이웃한 같은 칸을 모두 nibble 단위의
+ *                              비트 연산으로 찾으므로 게임판을 움직여 보지 않는다.
+ */
+static ALWAYS_INLINE board_t openCells(board_t b)
+{
+    return zeroNibbles(b)
+           | (zeroNibbles(b ^ (b >> 4)) & 0x0888088808880888ULL)
+           | (zeroNibbles(b ^ (b >> 16)) & 0x0000888888888888ULL);
+}
+
+/**
+ * @brief                       왼쪽/오른쪽으로 움직일 게임판만 전치해서 out 에 쓴다.
+ * @param board_t compare       NULL 이 아니면 out 에 쓰기 전의 이 값과 비교한다. (out 과 같아도 된다)
+ * @return uint64_t             compare 와 달라진 게임판의 비트가 켜진 마스크
+ */
+static uint64_t alignBoards(const board_t *in, const uint8_t *dirs, board_t *out, const board_t *compare, size_t n)
+{
+    board_t across, b;
+    uint64_t changed = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        across = (board_t) 0 - (dirs[i] >> 1);
+        b = (transposeBoard(in[i]) & across) | (in[i] & ~across);
+        if (compare != NULL) {
+            changed |= (uint64_t) (b != compare[i]) << i;
+        }
+        out[i] = b;
+    }
+    return changed;
+}
+
+static uint64_t endedBoards(const board_t *boards, size_t n)
+{
+    uint64_t ended = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        ended |= (uint64_t) (openCells(boards[i]) == 0) << i;
+    }
+    return ended;
+}
+
+#ifdef VECTOR_MOVES
+
+#define BATCH_TARGET                 __attribute__((target("avx2")))
+
+/**
+ * @brief                       transposeBoard, zeroNibbles 를 게임판 네 개에 한꺼번에 적용한다.
+ */
+static ALWAYS_INLINE BATCH_TARGET __m256i transposeBoards(__m256i b)
+{
+    __m256i a = _mm256_or_si256(_mm256_and_si256(b, _mm256_set1_epi64x(0xF0F00F0FF0F00F0FULL)),
+                                _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(b, _mm256_set1_epi64x(0x0000F0F00000F0F0ULL)), 12),
+                                                _mm256_srli_epi64(_mm256_and_si256(b, _mm256_set1_epi64x(0x0F0F00000F0F0000ULL)), 12)));
+    return _mm256_or_si256(_mm256_and_si256(a, _mm256_set1_epi64x(0xFF00FF0000FF00FFULL)),
+                           _mm256_or_si256(_mm256_srli_epi64(_mm256_and_si256(a, _mm256_set1_epi64x(0x00FF00FF00000000ULL)), 24),
+                                           _mm256_slli_epi64(_mm256_and_si256(a, _mm256_set1_epi64x(0x00000000FF00FF00ULL)), 24)));
+}
+
+static ALWAYS_INLINE BATCH_TARGET __m256i zeroNibbleBoards(__m256i v)
+{
+    const __m256i low = _mm256_set1_epi64x(0x7777777777777777ULL);
+    __m256i t = _mm256_add_epi64(_mm256_and_si256(v, low), low);
+    return _mm256_andnot_si256(_mm256_or_si256(_mm256_or_si256(t, v), low), _mm256_set1_epi64x(-1));
+}
+
+BATCH_TARGET static uint64_t alignBoardsAvx2(const board_t *in, const uint8_t *dirs, board_t *out, const board_t *compare,
+                                             size_t n)
+{
+    __m256i b, across;
+    uint64_t changed = 0;
+    uint32_t d;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        memcpy(&d, dirs + i, sizeof(d));
+        across = _mm256_cmpgt_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(d)), _mm256_set1_epi64x(1));
+        b = _mm256_loadu_si256((const __m256i *) (in + i));
+        b = _mm256_blendv_epi8(b, transposeBoards(b), across);
+        if (compare != NULL) {
+            changed |= (uint64_t) (~_mm256_movemask_pd(_mm256_castsi256_pd(
+                           _mm256_cmpeq_epi64(b, _mm256_loadu_si256((const __m256i *) (compare + i))))) & 0xF) << i;
+        }
+        _mm256_storeu_si256((__m256i *) (out + i), b);
+    }
+    // the rest of the program is SSE code, which is slow while the upper halves are dirty
+    _mm256_zeroupper();
+    // a full block leaves no tail, and shifting by 64 would be undefined
+    return i < n ? changed | alignBoards(in + i, dirs + i, out + i, compare != NULL ? compare + i : NULL, n - i) << i
+                 : changed;
+}
+
+BATCH_TARGET static uint64_t endedBoardsAvx2(const board_t *boards, size_t n)
+{
+    __m256i b, open;
+    uint64_t ended = 0;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        b = _mm256_loadu_si256((const __m256i *) (boards + i));
+        open = _mm256_or_si256(zeroNibbleBoards(b), _mm256_or_si256(
+                   _mm256_and_si256(zeroNibbleBoards(_mm256_xor_si256(b, _mm256_srli_epi64(b, 4))),
+                                    _mm256_set1_epi64x(0x0888088808880888ULL)),
+                   _mm256_and_si256(zeroNibbleBoards(_mm256_xor_si256(b, _mm256_srli_epi64(b, 16))),
+                                    _mm256_set1_epi64x(0x0000888888888888ULL))));
+        ended |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(open, _mm256_setzero_si256()))) << i;
+    }
+    _mm256_zeroupper();
+    return i < n ? ended | endedBoards(boards + i, n - i) << i : ended;
+}
+
+#endif
+
+/**
+ * @brief                       묶음 함수가 사용할 단계별 함수, initBatchKernels 가 CPU 에 맞게 고른다.
+ */
+static uint64_t (*alignKernel)(const board_t *, const uint8_t *, board_t *, const board_t *, size_t) = alignBoards;
+static uint64_t (*endedKernel)(const board_t *, size_t) = endedBoards;
+
+/**
+ * @brief                       AVX2 를 지원하면 묶음의 전치, 비교, 끝 검사를 게임판 네 개씩 처리한다.
+ */
+void initBatchKernels(void)
+{
+#ifdef VECTOR_MOVES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        alignKernel = alignBoardsAvx2;
+        endedKernel = endedBoardsAvx2;
+    }
+#endif
+}
+
+/**
+ * @brief                       묶음의 모든 게임판을 게임마다 주어진 방향으로 이동한다.
+ * @remark                      64게임씩 전치, 행 테이블 조회, 역전치와 비교를 단계별로 반복하므로
+ *                              방향에 따른 분기가 없고, 테이블 조회를 뺀 단계는 벡터 명령으로 처리한다.
+ * @param BoardBatch batch      게임 묶음
+ * @param uint8_t directions    게임마다 MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ * @param uint64_t changed      BATCH_WORDS(count) 개의 마스크, 게임판이 바뀐 게임의 비트가 켜진다.
+ */
+void batchMove(BoardBatch *batch, const uint8_t *directions, uint64_t *changed)
+{
+    board_t rows[BATCH_BLOCK];
+    board_t row;
+    const uint16_t *table;
+    unsigned int *scores;
+    size_t start, n, i;
+
+    for (start = 0; start < batch->count; start += BATCH_BLOCK) {
+        n = batch->count - start < BATCH_BLOCK ? batch->count - start : BATCH_BLOCK;
+        scores = batch->scores + start;
+        // left and right slide the rows of the transposed board
+        alignKernel(batch->boards + start, directions + start, rows, NULL, n);
+        for (i = 0; i < n; i++) {
+            table = directions[start + i] & 1 ? rowDownTable : rowUpTable;
+            row = rows[i];
+            rows[i] = (board_t) table[row & ROW_MASK]
+                      | (board_t) table[(row >> 16) & ROW_MASK] << 16
+                      | (board_t) table[(row >> 32) & ROW_MASK] << 32
+                      | (board_t) table[row >> 48] << 48;
+            scores[i] += rowScoreTable[row & ROW_MASK] + rowScoreTable[(row >> 16) & ROW_MASK]
+                         + rowScoreTable[(row >> 32) & ROW_MASK] + rowScoreTable[row >> 48];
+        }
+        changed[start / BATCH_BLOCK] = alignKernel(rows, directions + start, batch->boards + start,
+                                                   batch->boards + start, n);
+    }
+}
+
+/**
+ * @brief                       마스크에 켜진 게임마다 빈 칸 하나에 2 또는 4 를 추가한다.
+ * @remark                      게임마다 batch->rngs 의 난수 상태를 사용하고, packedAddRandom 과 같은 결과를 만든다.
+ * @param BoardBatch batch      게임 묶음
+ * @param uint64_t mask         BATCH_WORDS(count) 개의 마스크 (보통 batchMove 의 changed), NULL 이면 모든 게임
+ */
+void batchAddRandom(BoardBatch *batch, const uint64_t *mask)
+{
+    board_t empty;
+    size_t i;
+    unsigned int r, len;
+    board_t n;
+
+    for (i = 0; i < batch->count; i++) {
+        if (mask != NULL && !(mask[i / BATCH_BLOCK] >> (i % BATCH_BLOCK) & 1)) {
+            continue;
+        }
+        empty = zeroNibbles(batch->boards[i]);
+        len = __builtin_popcountll(empty);
+        if (len == 0) {
+            continue;
+        }
+        r = randomBelow(&batch->rngs[i], len);
+        n = randomBelow(&batch->rngs[i], 10) / 9 + 1;
+        batch->boards[i] |= n << (selectBit(empty, r) - 3);
+    }
+}
+
+/**
+ * @brief                       묶음에서 더 이상 움직일 수 없는 게임을 찾는다.
+ * @param BoardBatch batch      게임 묶음
+ * @param uint64_t ended        BATCH_WORDS(count) 개의 마스크, 끝난 게임의 비트가 켜진다.
+ */
+void batchGameEnded(const BoardBatch *batch, uint64_t *ended)
+{
+    size_t start, n;
+
+    for (start = 0; start < batch->count; start += BATCH_BLOCK) {
+        n = batch->count - start < BATCH_BLOCK ? batch->count - start : BATCH_BLOCK;
+        ended[start / BATCH_BLOCK] = endedKernel(batch->boards + start, n);
+    }
+}
+
+/**
+ * @brief 리플레이 파일 상수입니다
+ * @remark 게임 하나의 기록은 다음과 같고 여러 기록을 이어 붙일 수 있다. (모든 정수는 little endian)
+ *         헤더 32 바이트: "2048", 버전 (1), 게임판 크기, 예약 (2), 이동 수 (4), 난수 상태 (8),
+ *                         마지막 게임판 (board_t, 8), 마지막 점수 (4), 예약 (4)
+ *         이동: 이동 하나당 2비트 (MOVE_UP ~ MOVE_RIGHT), 한 바이트에 낮은 비트부터 4개
+ *         체크섬 8 바이트: 난수 상태에서 시작해 이동 후 새 블럭까지 추가된 게임판마다 replayChecksum
+ *         난수 상태는 처음 두 블럭을 추가하기 전의 상태이므로 이것만으로 게임 전체를 다시 만들 수 있다.
+ */
+#define REPLAY_MAGIC                 "2048"
+#define REPLAY_VERSION               1
+#define REPLAY_HEADER_SIZE           32
+#define REPLAY_CHECKSUM_SIZE         8
+
+/**
+ * @brief                       기본 스레드 수, 온라인 CPU 수를 알 수 없으면 1
+ */
+unsigned int onlineProcessors(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int) count : 1;
+}
+
+double elapsedSeconds(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief                       크기가 자동으로 늘어나는 바이트 버퍼에 덧붙인다.
+ * @return bool                 메모리가 부족하면 false
+ */
+bool appendBuffer(Buffer *buffer, const void *data, size_t length)
+{
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : 256;
+    uint8_t *grown;
+
+    if (buffer->length + length > buffer->capacity) {
+        while (capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+        grown = realloc(buffer->data, capacity);
+        if (grown == NULL) {
+            return false;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return true;
+}
+
+void freeBuffer(Buffer *buffer)
+{
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static void putLittleEndian(uint8_t *p, uint64_t value, unsigned int bytes)
+{
+    unsigned int i;
+    for (i = 0; i < bytes; i++) {
+        p[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static uint64_t getLittleEndian(const uint8_t *p, unsigned int bytes)
+{
+    uint64_t value = 0;
+    unsigned int i;
+    for (i = 0; i < bytes; i++) {
+        value |= (uint64_t) p[i] << (8 * i);
+    }
+    return value;
+}
+
+uint64_t replayChecksum(uint64_t checksum, board_t b)
+{
+    checksum = (checksum ^ b) * 0x100000001B3ULL;
+    return checksum ^ (checksum >> 29);
+}
+
+/**
+ * @brief                       체크섬과 리플레이 헤더에 기록할 게임판 요약 값
+ * @return board_t              4x4 게임판이면 packBoard 와 같고,
+ *                              다른 크기는 모든 칸의 지수로 계산한 FNV-1a 해시
+ */
+board_t boardDigest(Game *game)
+{
+    board_t digest = 0xCBF29CE484222325ULL;
+    unsigned int x, y;
+
+    if (game->size == SIZE) {
+        return packBoard(game->board);
+    }
+    for (x = 0; x < game->size; x++) {
+        for (y = 0; y < game->size; y++) {
+            digest = (digest ^ game->board[x][y]) * 0x100000001B3ULL;
+        }
+    }
+    return digest;
+}
+
+/**
+ * @brief                       새 게임의 기록을 시작한다.
+ * @param Replay replay         기록
+ * @param uint64_t rng          처음 두 블럭을 추가하기 전의 난수 상태
+ * @param unsigned int size     게임판 크기
+ */
+void startReplay(Replay *replay, uint64_t rng, unsigned int size)
+{
+    replay->seed = rng;
+    replay->checksum = rng;
+    replay->size = size;
+    replay->count = 0;
+    replay->moves.length = 0;
+    replay->started = true;
+}
+
+/**
+ * @brief                       성공한 이동 하나를 기록한다.
+ * @param unsigned int direction MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ */
+void recordMove(Replay *replay, unsigned int direction)
+{
+    uint8_t empty = 0;
+    if (replay->count % 4 == 0 && !appendBuffer(&replay->moves, &empty, 1)) {
+        replay->started = false;
+        return;
+    }
+    replay->moves.data[replay->count / 4] |= (uint8_t) (direction << (2 * (replay->count % 4)));
+    replay->count++;
+}
+
+/**
+ * @brief                       이동 후 새 블럭까지 추가된 게임판으로 체크섬을 갱신한다.
+ */
+void recordBoard(Replay *replay, board_t b)
+{
+    replay->checksum = replayChecksum(replay->checksum, b);
+}
+
+/**
+ * @brief                       기록한 게임 하나를 리플레이 형식으로 덧붙인다.
+ * @param Replay replay         기록
+ * @param board_t b             마지막 게임판 (boardDigest)
+ * @param unsigned int score    마지막 점수
+ * @param Buffer output         기록을 덧붙일 버퍼
+ * @return bool                 메모리가 부족하면 false
+ */
+bool encodeReplay(const Replay *replay, board_t b, unsigned int score, Buffer *output)
+{
+    uint8_t header[REPLAY_HEADER_SIZE] = {0};
+    uint8_t checksum[REPLAY_CHECKSUM_SIZE];
+
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    header[5] = (uint8_t) replay->size;
+    putLittleEndian(header + 8, replay->count, 4);
+    putLittleEndian(header + 12, replay->seed, 8);
+    putLittleEndian(header + 20, b, 8);
+    putLittleEndian(header + 28, score, 4);
+    putLittleEndian(checksum, replay->checksum, 8);
+    return appendBuffer(output, header, sizeof(header))
+           && appendBuffer(output, replay->moves.data, (replay->count + 3) / 4)
+           && appendBuffer(output, checksum, sizeof(checksum));
+}
+
+/**
+ * @brief                       기록 중인 게임을 파일에 쓰고 기록을 끝낸다.
+ * @param Replay replay         기록, 시작하지 않았으면 아무것도 하지 않는다.
+ * @param board_t b             마지막 게임판 (boardDigest)
+ * @param unsigned int score    마지막 점수
+ */
+void finishReplay(Replay *replay, board_t b, unsigned int score)
+{
+    Buffer record = {NULL, 0, 0};
+
+    if (replay == NULL || !replay->started) {
+        return;
+    }
+    if (encodeReplay(replay, b, score, &record)) {
+        fwrite(record.data, 1, record.length, replay->file);
+        fflush(replay->file);
+    }
+    freeBuffer(&record);
+    replay->started = false;
+}
+
+/**
+ * @brief                       4x4 가 아닌 게임판의 기록을 배열 게임판으로 다시 진행한다.
+ * @param uint8_t data          기록의 시작, 헤더는 verifyReplay 에서 검사했다.
+ * @param size_t bytes          이동 기록의 바이트 수, 헤더의 이동 수와 함께 verifyReplay 에서 검사했다.
+ * @param uint8_t p             이동 기록의 시작, 끝나면 체크섬 위치를 가리킨다.
+ * @return bool                 verifyReplay 참고
+ */
+static bool verifyArrayReplay(const uint8_t *data, size_t bytes, const uint8_t **p)
+{
+    Game game;
+    uint64_t count = getLittleEndian(data + 8, 4);
+    const uint8_t *end = *p + bytes;
+    uint64_t i;
+    uint8_t bits = 0;
+    uint64_t checksum;
+
+    memset(game.board, 0, sizeof(game.board));
+    if (!setBoardSize(&game, data[5])) {
+        return false;
+    }
+    refreshMasks(&game);
+    game.score = 0;
+    game.rng = getLittleEndian(data + 12, 8);
+    checksum = game.rng;
+    addRandom(&game);
+    addRandom(&game);
+    // the loop is bounded by the bytes that were checked, never by the count alone
+    for (i = 0; i < count && (i % 4 != 0 || *p < end); i++) {
+        if (i % 4 == 0) {
+            bits = *(*p)++;
+        }
+        if (!game.kernels->move[bits & 3](&game)) {
+            return false;
+        }
+        bits >>= 2;
+        addRandom(&game);
+        checksum = replayChecksum(checksum, boardDigest(&game));
+    }
+    return i == count
+           && boardDigest(&game) == getLittleEndian(data + 20, 8)
+           && game.score == getLittleEndian(data + 28, 4)
+           && checksum == getLittleEndian(*p, 8);
+}
+
+/**
+ * @brief                       리플레이 기록 하나를 다시 진행해서 검증한다.
+ * @param uint8_t data          기록의 시작
+ * @param size_t length         data 에서 읽을 수 있는 바이트 수
+ * @param size_t used           기록의 길이를 저장할 변수, 헤더가 잘못되었으면 0
+ * @param unsigned int moves    기록의 이동 수를 저장할 변수
+ * @return bool                 이동이 모두 가능하고 마지막 게임판, 점수, 체크섬이 맞으면 true
+ */
+bool verifyReplay(const uint8_t *data, size_t length, size_t *used, unsigned int *moves)
+{
+    uint64_t rng, checksum;
+    unsigned int count, score = 0;
+    unsigned int i;
+    uint8_t bits = 0;
+    const uint8_t *p;
+    board_t b, moved;
+
+    *used = 0;
+    *moves = 0;
+    if (length < REPLAY_HEADER_SIZE || memcmp(data, REPLAY_MAGIC, 4) != 0 || data[4] != REPLAY_VERSION) {
+        return false;
+    }
+    if (length < REPLAY_HEADER_SIZE + REPLAY_CHECKSUM_SIZE) {
+        return false;
+    }
+    // the count comes from the file, so it is checked against the bytes that are really there
+    // before (count + 3) / 4 is computed, which would wrap around in 32 bits
+    count = getLittleEndian(data + 8, 4);
+    if ((uint64_t) count > (uint64_t) (length - REPLAY_HEADER_SIZE - REPLAY_CHECKSUM_SIZE) * 4) {
+        return false;
+    }
+    *used = REPLAY_HEADER_SIZE + ((size_t) count + 3) / 4 + REPLAY_CHECKSUM_SIZE;
+    *moves = count;
+    p = data + REPLAY_HEADER_SIZE;
+    if (data[5] != SIZE) {
+        // other sizes do not fit in a board_t, so they are replayed on the array engine
+        return data[5] >= MIN_SIZE && data[5] <= MAX_SIZE
+               && verifyArrayReplay(data, ((size_t) count + 3) / 4, &p);
+    }
+
+    rng = getLittleEndian(data + 12, 8);
+    checksum = rng;
+    b = packedAddRandom(packedAddRandom(0, &rng), &rng);
+    for (i = 0; i < count; i++) {
+        if (i % 4 == 0) {
+            bits = *p++;
+        }
+        moved = packedMove(b, bits & 3, &score);
+        bits >>= 2;
+        if (moved == b) {
+            return false;
+        }
+        b = packedAddRandom(moved, &rng);
+        checksum = replayChecksum(checksum, b);
+    }
+    return b == getLittleEndian(data + 20, 8)
+           && score == getLittleEndian(data + 28, 4)
+           && checksum == getLittleEndian(p, 8);
+}
+
+/**
+ * @brief                       리플레이 파일들을 화면 출력 없이 다시 진행해서 검증한다.
+ * @remark                      파일은 mmap 으로 읽으므로 여러 기록을 이어 붙인 큰 파일도
+ *                              메모리에 한꺼번에 올리지 않고 처음부터 끝까지 훑을 수 있다.
+ * @param int argc              "replay" 이후 실행 파라미터의 개수
+ * @param int argv              검증할 파일 경로들
+ * @return int                  모든 기록이 맞으면 EXIT_SUCCESS
+ */
+int replayFiles(int argc, char *argv[])
+{
+    struct timespec start;
+    struct stat info;
+    unsigned long long records = 0, failed = 0, moves = 0;
+    unsigned int count;
+    size_t offset, used;
+    const uint8_t *data;
+    double seconds;
+    int i, fd;
+
+    if (argc == 0) {
+        fprintf(stderr, "usage: 2048 replay FILE...\n");
+        return EXIT_FAILURE;
+    }
+    initMoveTables();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < argc; i++) {
+        fd = open(argv[i], O_RDONLY);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            fprintf(stderr, "cannot open %s\n", argv[i]);
+            failed++;
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        if (info.st_size == 0) {
+            close(fd);
+            continue;
+        }
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "cannot map %s\n", argv[i]);
+            failed++;
+            continue;
+        }
+        posix_madvise((void *) data, info.st_size, POSIX_MADV_SEQUENTIAL);
+        for (offset = 0; offset < (size_t) info.st_size; offset += used) {
+            records++;
+            if (!verifyReplay(data + offset, info.st_size - offset, &used, &count)) {
+                failed++;
+                printf("%s: record %llu at offset %zu does not verify\n", argv[i], records, offset);
+                if (used == 0) {
+                    // the header is broken, so the next record cannot be found
+                    break;
+                }
+            }
+            moves += count;
+        }
+        munmap((void *) data, info.st_size);
+    }
+    seconds = elapsedSeconds(&start);
+    printf("records    %llu\n", records);
+    printf("failed     %llu\n", failed);
+    printf("moves      %llu\n", moves);
+    printf("moves/sec  %.1f\n", moves / seconds);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief                       steps 단계를 담을 되돌리기 기록을 할당한다.
+ * @param unsigned int steps    남길 단계 수, 2의 거듭제곱으로 올림한다.
+ * @return bool                 메모리가 부족하면 false
+ */
+bool initHistory(History *history, unsigned int steps)
+{
+    uint64_t capacity = 2;
+
+    while (capacity < steps) {
+        capacity *= 2;
+    }
+    memset(history, 0, sizeof(*history));
+    history->steps = malloc(capacity * sizeof(*history->steps));
+    history->mask = capacity - 1;
+    return history->steps != NULL;
+}
+
+void freeHistory(History *history)
+{
+    free(history->steps);
+    memset(history, 0, sizeof(*history));
+}
+
+static void saveStep(HistoryStep *step, const Game *game, unsigned int direction)
+{
+    const unsigned int n = game->size;
+    unsigned int x, y, i, value;
+
+    if (n <= SIZE) {
+        step->packed.board = 0;
+    } else {
+        memset(step->packed.cells, 0, (n * n + 1) / 2);
+    }
+    step->high = 0;
+    for (x = 0; x < n; x++) {
+        for (y = 0; y < n; y++) {
+            i = n * x + y;
+            value = game->board[x][y];
+            step->high |= (uint64_t) ((value >> 4) & 1) << i;
+            if (n <= SIZE) {
+                step->packed.board |= (uint64_t) (value & 0xF) << (4 * i);
+            } else {
+                step->packed.cells[i / 2] |= (uint8_t) ((value & 0xF) << (4 * (i % 2)));
+            }
+        }
+    }
+    step->rng = game->rng;
+    step->checksum = game->replay != NULL ? game->replay->checksum : 0;
+    step->score = game->score;
+    step->direction = direction;
+}
+
+static void loadStep(Game *game, const HistoryStep *step)
+{
+    const unsigned int n = game->size;
+    unsigned int x, y, i, value;
+
+    for (x = 0; x < n; x++) {
+        for (y = 0; y < n; y++) {
+            i = n * x + y;
+            if (n <= SIZE) {
+                value = (step->packed.board >> (4 * i)) & 0xF;
+            } else {
+                value = (step->packed.cells[i / 2] >> (4 * (i % 2))) & 0xF;
+            }
+            game->board[x][y] = value | (unsigned int) (((step->high >> i) & 1) << 4);
+        }
+    }
+    game->rng = step->rng;
+    game->score = step->score;
+    refreshMasks(game);
+}
+
+/**
+ * @brief                       board_t 게임판 하나를 단계로 남긴다. (4x4 세션 서버가 사용한다)
+ */
+static void savePackedStep(HistoryStep *step, board_t b, uint64_t rng, unsigned int score, unsigned int direction)
+{
+    step->packed.board = b;
+    step->high = 0;
+    step->rng = rng;
+    step->checksum = 0;
+    step->score = score;
+    step->direction = direction;
+}
+
+/**
+ * @brief                       기록을 지우고 첫 단계를 남길 자리를 돌려준다.
+ */
+static HistoryStep *clearHistory(History *history)
+{
+    history->first = history->current = history->last = 0;
+    return &history->steps[0];
+}
+
+/**
+ * @brief                       다음 단계를 남길 자리를 돌려준다.
+ * @remark                      되돌린 단계들은 다시 할 수 없게 되고, 가득 찼으면 가장 오래된 단계를 버린다.
+ */
+static HistoryStep *advanceHistory(History *history)
+{
+    history->last = ++history->current;
+    if (history->current - history->first > history->mask) {
+        history->first++;
+    }
+    return &history->steps[history->current & history->mask];
+}
+
+/**
+ * @brief                       한 단계 뒤로 가서 그 단계를 돌려준다.
+ * @return HistoryStep          되돌릴 단계가 없으면 NULL
+ */
+static const HistoryStep *rewindHistory(History *history)
+{
+    if (history->current == history->first) {
+        return NULL;
+    }
+    return &history->steps[--history->current & history->mask];
+}
+
+/**
+ * @brief                       rewindHistory 로 되돌린 단계 하나를 다시 앞으로 가서 돌려준다.
+ * @return HistoryStep          다시 할 단계가 없으면 NULL
+ */
+static const HistoryStep *forwardHistory(History *history)
+{
+    if (history->current == history->last) {
+        return NULL;
+    }
+    return &history->steps[++history->current & history->mask];
+}
+
+/**
+ * @brief                       기록을 지우고 지금 게임판을 첫 단계로 남긴다.
+ */
+void resetHistory(History *history, const Game *game)
+{
+    saveStep(clearHistory(history), game, MOVE_UP);
+}
+
+/**
+ * @brief                       이동 후 새 블럭까지 추가된 게임판을 다음 단계로 남긴다.
+ * @param unsigned int direction 이 단계로 온 이동 방향
+ */
+void pushHistory(History *history, const Game *game, unsigned int direction)
+{
+    saveStep(advanceHistory(history), game, direction);
+}
+
+/**
+ * @brief                       마지막 이동을 되돌린다.
+ * @remark                      난수 상태도 되돌리므로 같은 방향으로 다시 움직이면 같은 새 블럭이 나온다.
+ *                              리플레이를 기록 중이면 마지막 이동도 기록에서 지운다.
+ * @return bool                 되돌릴 단계가 없으면 false
+ */
+bool undoMove(Game *game)
+{
+    History *history = game->history;
+    Replay *replay = game->replay;
+    const HistoryStep *step;
+
+    step = history != NULL ? rewindHistory(history) : NULL;
+    if (step == NULL) {
+        return false;
+    }
+    loadStep(game, step);
+    if (replay != NULL && replay->started && replay->count > 0) {
+        replay->count--;
+        replay->moves.data[replay->count / 4] &= (uint8_t) ~(3u << (2 * (replay->count % 4)));
+        replay->moves.length = (replay->count + 3) / 4;
+        replay->checksum = step->checksum;
+    }
+    return true;
+}
+
+/**
+ * @brief                       undoMove 로 되돌린 이동을 다시 한다.
+ * @return bool                 다시 할 단계가 없으면 false
+ */
+bool redoMove(Game *game)
+{
+    History *history = game->history;
+    const HistoryStep *step;
+
+    step = history != NULL ? forwardHistory(history) : NULL;
+    if (step == NULL) {
+        return false;
+    }
+    loadStep(game, step);
+    if (game->replay != NULL && game->replay->started) {
+        recordMove(game->replay, step->direction);
+        game->replay->checksum = step->checksum;
+    }
+    return true;
+}
+
+/**
+ * @author        조유신 (cho8wola@sju.ac.kr)
+ * @brief         게임보드를 초기화하는 함수, 2차원 배열을 0으로 초기화한 후 난수 2개를 입력
+ * @param Game game 초기화할 게임, 난수 상태와 옵션은 유지된다.
+ */
+void initBoard(Game *game)
+{
+    if (game->replay != NULL) {
+        finishReplay(game->replay, boardDigest(game), game->score);
+        startReplay(game->replay, game->rng, game->size);
+    }
+    memset(game->board, 0, sizeof(game->board));
+    refreshMasks(game);
+    addRandom(game);
+    addRandom(game);
+    game->score = 0;
+    if (game->history != NULL) {
+        resetHistory(game->history, game);
+    }
+}
+
+/**
+ * @brief                       게임을 만들고 초기화한다.
+ * @param Game game             초기화할 게임
+ * @param uint64_t seed         난수 초기값
+ */
+void initGame(Game *game, uint64_t seed)
+{
+    memset(game, 0, sizeof(*game));
+    game->rng = seedRandom(seed, 0);
+    setBoardSize(game, SIZE);
+    initColorSchemes();
+    game->delay = DEFAULT_DELAY;
+    initBoard(game);
+}
+
+/**
+ * @author                      조유신 (cho8wola@sju.ac.kr)
+ * @brief                       버퍼 인풋을 설정하는 함수
+ */
+void setBufferedInput(bool enable)
+{
+    static bool enabled = true;
+    static struct termios old;
+    struct termios new;
+
+    if (enable && !enabled) {
+        // restore the former settings
+        tcsetattr(STDIN_FILENO, TCSANOW, &old);
+        // set the new state
+        enabled = true;
+    } 
+    else {
+        if (!enable && enabled) {
+            // get the terminal settings for standard input
+            tcgetattr(STDIN_FILENO, &new);
+            // we want to keep the old setting to restore them at the end
+            old = new;
+            // disable canonical mode (buffered i/o) and local echo
+            new.c_lflag &= (~ICANON & ~ECHO);
+            // set the new settings immediately
+            tcsetattr(STDIN_FILENO, TCSANOW, &new);
+            // set the new state
+            enabled = false;
+        }
+    }
+}
+
+
+/**
+ * @brief                       배열 게임판과 board_t 게임판의 네 방향 이동 결과를 비교한다.
+ * @param Game game             비교에 사용할 게임 (변경되지 않음)
+ * @return bool                 게임판과 점수가 모든 방향에서 같으면 true
+ */
+bool testPackedMoves(const Game *game)
+{
+    bool (*moves[])(Game *) = {moveUp, moveDown, moveLeft, moveRight};
+    board_t (*packedMoves[])(board_t, unsigned int *) = {packedMoveUp, packedMoveDown, packedMoveLeft, packedMoveRight};
+    Game copy;
+    unsigned int gained;
+    unsigned int d;
+    board_t packed;
+    bool success = true;
+
+    for (d = 0; d < MOVE_COUNT; d++) {
+        copy = *game;
+        copy.score = 0;
+        gained = 0;
+        packed = packedMoves[d](packBoard(copy.board), &gained);
+        moves[d](&copy);
+        if (packed != packBoard(copy.board) || gained != copy.score) {
+            success = false;
+        }
+    }
+    return success;
+}
+
+/**
+ * @brief                       무작위 게임판에서 SIMD 이동과 스칼라 이동의 결과를 비교한다.
+ * @param unsigned int size     게임판 크기, SIMD 이동이 없는 크기이면 바로 true
+ * @return bool                 게임판, 점수, 이동 여부가 모두 같으면 true
+ */
+bool testVectorMoves(unsigned int size)
+{
+    Game scalar, vector;
+    uint64_t rng = seedRandom(size, 0);
+    unsigned int i, x, y, d;
+    bool moved;
+
+    if (vectorKernels[size].size == 0) {
+        return true;
+    }
+    setBoardSize(&vector, size);
+    for (i = 0; i < 4000; i++) {
+        for (x = 0; x < MAX_SIZE; x++) {
+            for (y = 0; y < MAX_SIZE; y++) {
+                // small values for many merges, and cells outside the board must stay untouched
+                vector.board[x][y] = x >= size || y >= size ? 7 : randomBelow(&rng, 3) == 0 ? 0 : randomBelow(&rng, 4) + 1;
+            }
+        }
+        vector.score = 0;
+        refreshMasks(&vector);
+        scalar = vector;
+        d = i % MOVE_COUNT;
+        moved = boardKernels[size]->move[d](&scalar);
+        if (vector.kernels->move[d](&vector) != moved || vector.score != scalar.score
+            || vector.empty != scalar.empty || vector.pairs != scalar.pairs
+            || memcmp(vector.board, scalar.board, sizeof(vector.board)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief                       묶음 함수들의 결과를 게임판 하나씩 진행한 packed 함수의 결과와 비교한다.
+ * @return bool                 게임판, 점수, 마스크가 모두 같으면 true
+ */
+bool testBatch(void)
+{
+    enum { COUNT = 200 };
+    board_t boards[COUNT], original[COUNT], expected[COUNT];
+    unsigned int scores[COUNT], gained[COUNT];
+    uint64_t rngs[COUNT], spawn, rng = seedRandom(2048, 0);
+    uint64_t changed[BATCH_WORDS(COUNT)], ended[BATCH_WORDS(COUNT)];
+    uint8_t directions[COUNT];
+    BoardBatch batch = {COUNT, boards, scores, rngs};
+    unsigned int i, c, d;
+    bool stuck;
+
+    for (i = 0; i < COUNT; i++) {
+        boards[i] = 0;
+        for (c = 0; c < SIZE * SIZE; c++) {
+            // every third board is a checkerboard, which is stuck unless a cell is changed below
+            boards[i] |= (board_t) (i % 3 == 0 ? 1 + (c / 4 + c) % 2 : randomBelow(&rng, 4)) << (4 * c);
+        }
+        if (i % 6 == 0) {
+            boards[i] ^= (board_t) 3 << (4 * randomBelow(&rng, SIZE * SIZE));
+        }
+        original[i] = boards[i];
+        directions[i] = randomBelow(&rng, MOVE_COUNT);
+        scores[i] = 0;
+        gained[i] = 0;
+        rngs[i] = seedRandom(i, 1);
+        expected[i] = packedMove(boards[i], directions[i], &gained[i]);
+    }
+    batchMove(&batch, directions, changed);
+    for (i = 0; i < COUNT; i++) {
+        if (boards[i] != expected[i] || scores[i] != gained[i]
+            || (changed[i / BATCH_BLOCK] >> (i % BATCH_BLOCK) & 1) != (expected[i] != original[i])) {
+            return false;
+        }
+    }
+
+    batchAddRandom(&batch, changed);
+    for (i = 0; i < COUNT; i++) {
+        spawn = seedRandom(i, 1);
+        if (expected[i] != original[i]) {
+            expected[i] = packedAddRandom(expected[i], &spawn);
+        }
+        if (boards[i] != expected[i] || rngs[i] != spawn) {
+            return false;
+        }
+    }
+
+    batchGameEnded(&batch, ended);
+    for (i = 0; i < COUNT; i++) {
+        stuck = true;
+        for (d = 0; d < MOVE_COUNT; d++) {
+            stuck &= packedMove(boards[i], d, &c) == boards[i];
+        }
+        if ((ended[i / BATCH_BLOCK] >> (i % BATCH_BLOCK) & 1) != stuck) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief                       무작위 게임을 진행하면서 빈 칸, 이웃 마스크와 selectBit 를 직접 계산한 값과 비교한다.
+ * @param unsigned int size     게임판 크기
+ * @return bool                 매 이동과 블럭 추가 뒤의 마스크와 gameEnded 가 모두 맞으면 true
+ */
+bool testMasks(unsigned int size)
+{
+    Game game, copy;
+    uint64_t empty, pairs, mask, rng = seedRandom(size, 1);
+    unsigned int i, k, x, y, bit, games, steps;
+    bool movable;
+
+    // select against a plain scan of the set bits
+    for (i = 0; i < 1000; i++) {
+        mask = nextRandom64(&rng);
+        mask &= nextRandom64(&rng);
+        for (k = 0, bit = 0; bit < 64; bit++) {
+            if ((mask >> bit & 1) && (selectBit(mask, k) != bit || selectBitPortable(mask, k++) != bit)) {
+                return false;
+            }
+        }
+    }
+    initGame(&game, size);
+    setBoardSize(&game, size);
+    for (games = 0; games < 20; games++) {
+        initBoard(&game);
+        // large boards rarely end under random moves, so they only check a game prefix
+        steps = 0;
+        do {
+            empty = 0;
+            pairs = 0;
+            for (x = 0; x < size; x++) {
+                for (y = 0; y < size; y++) {
+                    bit = 8 * x + y;
+                    if (game.board[x][y] == 0) {
+                        empty |= (uint64_t) 1 << bit;
+                    } else if ((y + 1 < size && game.board[x][y + 1] == game.board[x][y])
+                               || (x + 1 < size && game.board[x + 1][y] == game.board[x][y])) {
+                        pairs |= (uint64_t) 1 << bit;
+                    }
+                }
+            }
+            movable = false;
+            for (i = 0; i < MOVE_COUNT; i++) {
+                copy = game;
+                movable |= copy.kernels->move[i](&copy);
+            }
+            if (game.empty != empty || game.pairs != pairs || gameEnded(&game) == movable) {
+                return false;
+            }
+            for (i = randomBelow(&rng, MOVE_COUNT); movable && !game.kernels->move[i](&game); i = (i + 1) % MOVE_COUNT) {
+            }
+            addRandom(&game);
+        } while (movable && ++steps < 500);
+    }
+    return true;
+}
+
+/**
+ * @brief                       리플레이 기록을 저장했다가 다시 검증하고, 잘못된 헤더를 거부하는지 확인한다.
+ * @return bool                 저장한 기록은 검증되고, 이동 수가 파일보다 크거나 잘리거나
+ *                              체크섬이 틀린 기록은 모두 거부되면 true
+ */
+bool testReplay(void)
+{
+    Replay replay;
+    Buffer record = {NULL, 0, 0};
+    uint8_t *copy;
+    uint64_t rng = seedRandom(11, 0);
+    uint64_t spawn = seedRandom(11, 1);
+    board_t b, moved;
+    unsigned int i, d, tries, moves;
+    unsigned int score = 0;
+    size_t used;
+    bool success = true;
+
+    memset(&replay, 0, sizeof(replay));
+    startReplay(&replay, spawn, SIZE);
+    b = packedAddRandom(packedAddRandom(0, &spawn), &spawn);
+    for (i = 0; i < 300; i++) {
+        d = randomBelow(&rng, MOVE_COUNT);
+        for (tries = 0; tries < MOVE_COUNT && (moved = packedMove(b, d, &score)) == b; tries++) {
+            d = (d + 1) % MOVE_COUNT;
+        }
+        if (tries == MOVE_COUNT) {
+            break;
+        }
+        recordMove(&replay, d);
+        b = packedAddRandom(moved, &spawn);
+        recordBoard(&replay, b);
+    }
+    if (!encodeReplay(&replay, b, score, &record)) {
+        freeBuffer(&replay.moves);
+        return false;
+    }
+    freeBuffer(&replay.moves);
+    success = verifyReplay(record.data, record.length, &used, &moves) && used == record.length && moves == i;
+
+    // the broken records are checked inside a larger zeroed buffer so that a wrapped length would stay mapped
+    copy = calloc(4096, 1);
+    if (copy == NULL) {
+        freeBuffer(&record);
+        return false;
+    }
+    memcpy(copy, record.data, record.length);
+    putLittleEndian(copy + 8, 0xFFFFFFFFu, 4);
+    success = success && !verifyReplay(copy, 4096, &used, &moves) && used == 0;
+    putLittleEndian(copy + 8, 0xFFFFFFFDu, 4);
+    success = success && !verifyReplay(copy, 4096, &used, &moves) && used == 0;
+    putLittleEndian(copy + 8, (record.length - REPLAY_HEADER_SIZE - REPLAY_CHECKSUM_SIZE) * 4 + 1, 4);
+    success = success && !verifyReplay(copy, record.length, &used, &moves) && used == 0;
+    memcpy(copy, record.data, record.length);
+    success = success && !verifyReplay(copy, record.length - 1, &used, &moves) && used == 0
+              && !verifyReplay(copy, REPLAY_HEADER_SIZE + REPLAY_CHECKSUM_SIZE - 1, &used, &moves);
+    copy[record.length - 1] ^= 1;
+    success = success && !verifyReplay(copy, record.length, &used, &moves) && used == record.length;
+    copy[5] = MAX_SIZE + 1;
+    success = success && !verifyReplay(copy, record.length, &used, &moves);
+
+    free(copy);
+    freeBuffer(&record);
+    return success;
+}
+
+/**
+ * @brief                       되돌리기/다시 하기가 게임판, 점수, 리플레이 기록을 그대로 되돌리는지 확인한다.
+ * @return bool                 링 버퍼 크기만큼만 되돌리고, 되돌린 뒤 다시 진행한 기록이 검증되면 true
+ */
+bool testHistory(void)
+{
+    Game game;
+    History history;
+    Replay replay;
+    Buffer record = {NULL, 0, 0};
+    Game scratch;
+    HistoryStep step;
+    unsigned int boards[24][MAX_SIZE][MAX_SIZE];
+    unsigned int scores[24];
+    unsigned int i, d, moves, n, x, y;
+    uint64_t rng = seedRandom(9, 0);
+    size_t used;
+    bool success = true;
+
+    memset(&replay, 0, sizeof(replay));
+    initGame(&game, 5);
+    setBoardSize(&game, 5);
+    if (!initHistory(&history, 8)) {
+        return false;
+    }
+    game.replay = &replay;
+    game.history = &history;
+    initBoard(&game);
+    memcpy(boards[0], game.board, sizeof(game.board));
+    scores[0] = game.score;
+    for (i = 1; i < 24; i++) {
+        // the directions come from their own stream so that the record only depends on game.rng
+        for (d = randomBelow(&rng, MOVE_COUNT); !game.kernels->move[d](&game); d = (d + 1) % MOVE_COUNT) {
+        }
+        recordMove(&replay, d);
+        addRandom(&game);
+        recordBoard(&replay, boardDigest(&game));
+        pushHistory(&history, &game, d);
+        memcpy(boards[i], game.board, sizeof(game.board));
+        scores[i] = game.score;
+    }
+    // only the last 8 boards are kept
+    for (i = 22; i >= 16; i--) {
+        success = success && undoMove(&game) && memcmp(game.board, boards[i], sizeof(game.board)) == 0
+                  && game.score == scores[i];
+    }
+    success = success && !undoMove(&game) && replay.count == 16;
+    for (i = 17; i <= 19; i++) {
+        success = success && redoMove(&game) && memcmp(game.board, boards[i], sizeof(game.board)) == 0
+                  && game.score == scores[i];
+    }
+    // a new move drops the undone boards
+    for (d = 0; !game.kernels->move[d](&game); d++) {
+    }
+    recordMove(&replay, d);
+    addRandom(&game);
+    recordBoard(&replay, boardDigest(&game));
+    pushHistory(&history, &game, d);
+    success = success && !redoMove(&game) && undoMove(&game) && redoMove(&game);
+    // the rewound record replays to the same board
+    success = success && encodeReplay(&replay, boardDigest(&game), game.score, &record)
+              && verifyReplay(record.data, record.length, &used, &moves) && used == record.length && moves == 20;
+
+    // the packed steps keep every exponent up to 31 on every size
+    for (n = MIN_SIZE; success && n <= MAX_SIZE; n++) {
+        setBoardSize(&game, n);
+        setBoardSize(&scratch, n);
+        memset(game.board, 0, sizeof(game.board));
+        for (x = 0; x < n; x++) {
+            for (y = 0; y < n; y++) {
+                game.board[x][y] = (7 * x + 3 * y + n) % TILE_LEVELS;
+            }
+        }
+        memset(scratch.board, 0, sizeof(scratch.board));
+        saveStep(&step, &game, MOVE_LEFT);
+        loadStep(&scratch, &step);
+        success = memcmp(scratch.board, game.board, sizeof(game.board)) == 0;
+    }
+
+    freeBuffer(&record);
+    freeBuffer(&replay.moves);
+    freeHistory(&history);
+    return success;
+}
+
+/**
+ * @brief                       게임판과 점수, 마스크만 복사한다. (화면은 복사하지 않는다)
+ */
+static void copyBoardState(Game *to, const Game *from)
+{
+    memcpy(to->board, from->board, sizeof(to->board));
+    to->size = from->size;
+    to->kernels = from->kernels;
+    to->empty = from->empty;
+    to->pairs = from->pairs;
+    to->score = from->score;
+}
+
+static bool sameBoardState(const Game *a, const Game *b)
+{
+    return memcmp(a->board, b->board, sizeof(a->board)) == 0 && a->score == b->score
+           && a->empty == b->empty && a->pairs == b->pairs;
+}
+
+/**
+ * @brief                       기준 이동, 처음 구현처럼 게임판을 돌려서 위쪽으로 slideArray 한 뒤 다시 돌려놓는다.
+ * @remark                      함수 테이블을 거치지 않고 findTarget 으로 미는 slideArrayN 을 직접 부르므로,
+ *                              slideLineN, SIMD 이동, 행 테이블과 코드를 공유하지 않는다.
+ * @param Game game             게임
+ * @param unsigned int direction MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ * @return bool                 하나의 블럭이라도 이동했다면 true
+ */
+bool referenceMove(Game *game, unsigned int direction)
+{
+    // counterclockwise quarter turns that bring each direction to the top
+    static const unsigned int turns[MOVE_COUNT] = {0, 2, 1, 3};
+    bool success = false;
+    unsigned int i, x;
+
+    for (i = 0; i < turns[direction]; i++) {
+        rotateBoardN(game->board, game->size);
+    }
+    for (x = 0; x < game->size; x++) {
+        success |= slideArrayN(game, x, game->size);
+    }
+    for (i = turns[direction]; i % 4 != 0; i++) {
+        rotateBoardN(game->board, game->size);
+    }
+    refreshMasks(game);
+    return success;
+}
+
+/**
+ * @brief                       한 게임판에서 네 방향 모두 빠른 이동 함수들을 기준 이동과 비교한다.
+ * @remark                      game->kernels (SIMD 가 있으면 SIMD), 크기별 스칼라 함수, 4x4 이면 board_t 이동까지
+ *                              성공 여부, 게임판, 점수, 빈 칸/짝 마스크가 모두 같아야 한다.
+ *                              board_t 는 지수 15 까지만 담으므로 그보다 큰 블럭이 있으면 board_t 이동은 건너뛴다.
+ * @param Game game             비교할 게임판, 마스크가 맞아야 한다. (변경되지 않음)
+ * @return int                  모두 같으면 -1, 아니면 처음으로 다른 방향
+ */
+int verifyMoves(const Game *game)
+{
+    Game reference, scalar, fast;
+    board_t packed = 0;
+    unsigned int d, x, y, gained;
+    bool packable = game->size == SIZE;
+    bool moved;
+
+    for (x = 0; x < game->size; x++) {
+        for (y = 0; y < game->size; y++) {
+            packable = packable && game->board[x][y] < 16;
+        }
+    }
+    for (d = 0; d < MOVE_COUNT; d++) {
+        copyBoardState(&reference, game);
+        copyBoardState(&scalar, game);
+        copyBoardState(&fast, game);
+        if (packable) {
+            packed = packBoard(scalar.board);
+        }
+        moved = referenceMove(&reference, d);
+        if (boardKernels[game->size]->move[d](&scalar) != moved || fast.kernels->move[d](&fast) != moved
+            || !sameBoardState(&scalar, &reference) || !sameBoardState(&fast, &reference)) {
+            return d;
+        }
+        gained = 0;
+        if (packable && (packedMove(packed, d, &gained) != packBoard(reference.board)
+                                   || game->score + gained != reference.score)) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+static void printMismatch(const Game *game, int direction)
+{
+    static const char *const names[MOVE_COUNT] = {"up", "down", "left", "right"};
+    unsigned int x, y;
+
+    printf("%ux%u move %s mismatch on\n", game->size, game->size, names[direction]);
+    for (y = 0; y < game->size; y++) {
+        for (x = 0; x < game->size; x++) {
+            printf(" %2u", game->board[x][y]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief                       4칸짜리 줄 65536 가지를 모두 네 방향으로 기준 이동과 비교한다.
+ * @remark                      board[x][y] 를 줄의 (x + y) % 4 번째 칸으로 채우므로 모든 행과 열이 같은 줄을
+ *                              돌린 것이고, 모든 줄과 뒤집은 줄이 한 번씩 나오므로 줄마다 모든 방향을 지난다.
+ * @return bool                 모두 같으면 true
+ */
+bool verifyRows(void)
+{
+    Game game;
+    unsigned int row, x, y;
+    int d;
+
+    memset(game.board, 0, sizeof(game.board));
+    setBoardSize(&game, SIZE);
+    for (row = 0; row < ROW_COUNT; row++) {
+        for (x = 0; x < SIZE; x++) {
+            for (y = 0; y < SIZE; y++) {
+                game.board[x][y] = (row >> (4 * ((x + y) % SIZE))) & 0xF;
+            }
+        }
+        game.score = 0;
+        refreshMasks(&game);
+        d = verifyMoves(&game);
+        if (d >= 0) {
+            printMismatch(&game, d);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief                       무작위 게임을 진행하면서 매 단계마다 네 방향 모두 기준 이동과 비교한다.
+ * @param unsigned int size     게임판 크기
+ * @param unsigned long games   게임 수
+ * @param uint64_t seed         난수 초기값, g 번째 게임은 seedRandom(seed, g)
+ * @param unsigned int limit    게임마다 최대 이동 수
+ * @param unsigned long long moves 진행한 이동 수를 더할 변수
+ * @return bool                 모두 같으면 true
+ */
+bool verifyGames(unsigned int size, unsigned long games, uint64_t seed, unsigned int limit, unsigned long long *moves)
+{
+    Game game;
+    unsigned long g;
+    unsigned int steps, d;
+    int mismatch;
+
+    for (g = 0; g < games; g++) {
+        memset(game.board, 0, sizeof(game.board));
+        setBoardSize(&game, size);
+        refreshMasks(&game);
+        game.score = 0;
+        game.rng = seedRandom(seed, g);
+        addRandom(&game);
+        addRandom(&game);
+        for (steps = 0; steps < limit && !gameEnded(&game); steps++) {
+            mismatch = verifyMoves(&game);
+            if (mismatch >= 0) {
+                printMismatch(&game, mismatch);
+                return false;
+            }
+            for (d = randomBelow(&game.rng, MOVE_COUNT); !game.kernels->move[d](&game); d = (d + 1) % MOVE_COUNT) {
+            }
+            addRandom(&game);
+        }
+        *moves += steps;
+    }
+    return true;
+}
+
+/**
+ * @brief                       이동 함수 검증 모드 ("verify" 실행 모드)
+ * @remark                      verifyRows 로 모든 줄을 확인한 뒤 MIN_SIZE 부터 MAX_SIZE 까지 크기마다
+ *                              --games 판 (기본 100) 의 무작위 게임을 끝나거나 --moves 번 (기본 10000) 이동할 때까지
+ *                              verifyGames 로 확인한다. 큰 게임판의 무작위 게임은 수백만 번 이동해야 끝난다.
+ * @param int argc              "verify" 이후 실행 파라미터의 개수
+ * @param int argv              "verify" 이후 실행 파라미터 값들의 배열
+ * @return int                  모두 같으면 EXIT_SUCCESS
+ */
+int verify(int argc, char *argv[])
+{
+    struct timespec start;
+    unsigned long games = 100;
+    unsigned int limit = 10000;
+    unsigned long long moves;
+    uint64_t seed = time(NULL);
+    unsigned int n;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--games") == 0) {
+            games = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--moves") == 0) {
+            limit = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: 2048 verify [--games N] [--seed N] [--moves N]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    initMoveTables();
+    printf("kernels  %s, seed %llu\n", initVectorKernels(), (unsigned long long) seed);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!verifyRows()) {
+        return EXIT_FAILURE;
+    }
+    printf("rows     %d x %d directions ok (%.2f s)\n", ROW_COUNT, MOVE_COUNT, elapsedSeconds(&start));
+    for (n = MIN_SIZE; n <= MAX_SIZE; n++) {
+        moves = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!verifyGames(n, games, seed, limit, &moves)) {
+            return EXIT_FAILURE;
+        }
+        printf("%ux%u      %lu games, %llu moves ok (%.2f s)\n", n, n, games, moves, elapsedSeconds(&start));
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief                       이동과 블럭 추가가 실행 통계를 맞게 세는지 확인한다.
+ * @return bool                 모든 크기에서 줄 수, merge 수, 블럭 추가 수가 맞으면 true (NO_STATS 이면 항상 true)
+ */
+#ifdef STATS
+static void *countStats(void *arg)
+{
+    Game game;
+
+    (void) arg;
+    initGame(&game, 4);
+    // only the move and the spawn below are counted
+    memset(&threadStats, 0, sizeof(threadStats));
+    moveLeft(&game);
+    addRandom(&game);
+    mergeStats();
+    return NULL;
+}
+#endif
+
+bool testStats(void)
+{
+#ifdef STATS
+    pthread_t thread;
+    Game game;
+    Stats before;
+    unsigned int n, x;
+    bool enabled = statsEnabled;
+    bool success = true;
+
+    // nothing is counted without --stats
+    statsEnabled = false;
+    before = threadStats;
+    initGame(&game, 3);
+    moveLeft(&game);
+    addRandom(&game);
+    success = memcmp(&before, &threadStats, sizeof(before)) == 0;
+    statsEnabled = true;
+    for (n = MIN_SIZE; n <= MAX_SIZE; n++) {
+        setBoardSize(&game, n);
+        memset(game.board, 0, sizeof(game.board));
+        for (x = 0; x < n; x++) {
+            game.board[x][0] = 1;
+        }
+        refreshMasks(&game);
+        before = threadStats;
+        // a row of 2s makes n / 2 fours on the scalar and the vector kernels alike
+        success &= moveLeft(&game) && threadStats.lines - before.lines == n
+                   && threadStats.merges[2] - before.merges[2] == n / 2;
+        addRandom(&game);
+        success &= threadStats.spawns - before.spawns == 1;
+    }
+    // the reference slide counts its calls and the cells findTarget looks at, not lines
+    memset(game.board, 0, sizeof(game.board));
+    game.board[0][0] = 1;
+    game.board[0][SIZE - 1] = 1;
+    setBoardSize(&game, SIZE);
+    before = threadStats;
+    success &= slideArray(&game, 0) && threadStats.slides - before.slides == 1
+               && threadStats.targetSteps - before.targetSteps == SIZE - 1 && threadStats.lines == before.lines;
+    // a worker thread's counters reach the totals when it merges them
+    pthread_mutex_lock(&statsLock);
+    before = totalStats;
+    pthread_mutex_unlock(&statsLock);
+    if (pthread_create(&thread, NULL, countStats, NULL) == 0) {
+        pthread_join(thread, NULL);
+        pthread_mutex_lock(&statsLock);
+        success &= totalStats.lines - before.lines == SIZE && totalStats.spawns - before.spawns == 1;
+        pthread_mutex_unlock(&statsLock);
+    } else {
+        success = false;
+    }
+    statsEnabled = enabled;
+    return success;
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief                       대칭 변환, 대표 게임판, Zobrist 해시를 확인한다.
+ * @return bool                 무작위 게임의 모든 게임판에서 8가지 대칭의 대표 게임판이 같고, 변환과 이동 방향이
+ *                              맞으며, 이동과 블럭 추가로 갱신한 해시가 boardHash 와 같으면 true
+ */
+bool testSymmetry(void)
+{
+    uint64_t rng = seedRandom(22, 0);
+    uint64_t hash;
+    board_t b, canonical, moved, spawned;
+    unsigned int transform, t, d, gained, steps;
+
+    b = packedAddRandom(packedAddRandom(0, &rng), &rng);
+    hash = boardHash(b);
+    for (steps = 0; steps < 2000; steps++) {
+        canonical = canonicalBoard(b, &transform);
+        if (applySymmetry(b, transform) != canonical || invertSymmetry(canonical, transform) != b) {
+            return false;
+        }
+        for (t = 0; t < SYMMETRY_COUNT; t++) {
+            if (canonicalBoard(applySymmetry(b, t), NULL) != canonical) {
+                return false;
+            }
+            for (d = 0; d < MOVE_COUNT; d++) {
+                gained = 0;
+                if (packedMove(applySymmetry(b, t), symmetryDirection(d, t), &gained)
+                    != applySymmetry(packedMove(b, d, &gained), t)) {
+                    return false;
+                }
+            }
+        }
+        d = randomBelow(&rng, MOVE_COUNT);
+        moved = packedMove(b, d, &gained);
+        if (moved == b) {
+            if (openCells(b) == 0) {
+                b = packedAddRandom(packedAddRandom(0, &rng), &rng);
+                hash = boardHash(b);
+            }
+            continue;
+        }
+        hash = hashMove(hash, b, moved);
+        spawned = packedAddRandom(moved, &rng);
+        // the new tile is the only nibble that differs
+        t = __builtin_ctzll(spawned ^ moved) / 4;
+        hash = hashSpawn(hash, t, (spawned >> (4 * t)) & 0xF);
+        b = spawned;
+        if (hash != boardHash(b)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testRollouts(void);
+bool testTablebase(void);
+bool testAnalysis(void);
+bool testAnalytics(void);
+bool testTuples(void);
+bool testServe(void);
+
+/**
+ * @author                      조유신 (cho8wola@sju.ac.kr)
+ * @brief                       게임을 테스트하는 함수, 테스트 케이스를 통해 임의의 키보드 입력 이벤트로 검사
+ * @return int | boolean
+ */
+int test()
+{
+    unsigned long long moves = 0;
+    Game game;
+    unsigned int (*board)[MAX_SIZE] = game.board;
+    // 2의 제곱으로 변환 (1=2 2=4 3=8)
+    unsigned int data[] = {
+            0, 0, 0, 1, 1, 0, 0, 0,
+            0, 0, 1, 1, 2, 0, 0, 0,
+            0, 1, 0, 1, 2, 0, 0, 0,
+            1, 0, 0, 1, 2, 0, 0, 0,
+            1, 0, 1, 0, 2, 0, 0, 0,
+            1, 1, 1, 0, 2, 1, 0, 0,
+            1, 0, 1, 1, 2, 1, 0, 0,
+            1, 1, 0, 1, 2, 1, 0, 0,
+            1, 1, 1, 1, 2, 2, 0, 0,
+            2, 2, 1, 1, 3, 2, 0, 0,
+            1, 1, 2, 2, 2, 3, 0, 0,
+            3, 0, 1, 1, 3, 2, 0, 0,
+            2, 0, 1, 1, 2, 2, 0, 0
+    };
+    unsigned int *in, *out;
+    unsigned int t, tests;
+    unsigned int i, x, n;
+    bool success = true;
+    bool passed;
+
+    initMoveTables();
+    initGame(&game, 0);
+    tests = (sizeof(data) / sizeof(data[0])) / (2 * SIZE);
+    for (t = 0; t < tests; t++) {
+        in = data + t * 2 * SIZE;
+        out = in + SIZE;
+        for (i = 0; i < SIZE; i++) {
+            board[0][i] = in[i];
+        }
+        slideArray(&game, 0);
+        passed = true;
+        for (i = 0; i < SIZE; i++) {
+            if (board[0][i] != out[i]) {
+                passed = false;
+            }
+        }
+        // every failing case is reported, not only the first one
+        if (!passed) {
+            success = false;
+            for (i = 0; i < SIZE; i++) {
+                printf("%d ", in[i]);
+            }
+            printf("=> ");
+            for (i = 0; i < SIZE; i++) {
+                printf("%d ", board[0][i]);
+            }
+            printf("expected ");
+            for (i = 0; i < SIZE; i++) {
+                printf("%d ", in[i]);
+            }
+            printf("=> ");
+            for (i = 0; i < SIZE; i++) {
+                printf("%d ", out[i]);
+            }
+            printf("\n");
+        }
+        // the same row in every column and orientation through the packed engine
+        for (x = 0; x < SIZE; x++) {
+            for (i = 0; i < SIZE; i++) {
+                board[x][i] = in[(i + x) % SIZE];
+            }
+        }
+        if (!testPackedMoves(&game)) {
+            printf("packed move mismatch for ");
+            for (i = 0; i < SIZE; i++) {
+                printf("%d ", in[i]);
+            }
+            printf("\n");
+            success = false;
+        }
+    }
+    // every size: a full row of 2s merges pairwise and leaves nothing beyond the board
+    for (n = MIN_SIZE; success && n <= MAX_SIZE; n++) {
+        setBoardSize(&game, n);
+        memset(board, 0, sizeof(game.board));
+        for (x = 0; x < n; x++) {
+            board[x][n - 1] = 1;
+        }
+        game.score = 0;
+        if (!moveRight(&game) || !moveUp(&game) || game.score != 4 * (n / 2)) {
+            success = false;
+        }
+        for (x = 0; x < MAX_SIZE; x++) {
+            for (i = 0; i < MAX_SIZE; i++) {
+                if (board[x][i] != (i != 0 || x >= n ? 0u : x >= n - n / 2 ? 2u : x == n / 2 && n % 2 ? 1u : 0u)) {
+                    success = false;
+                }
+            }
+        }
+        if (!success) {
+            printf("%ux%u move mismatch\n", n, n);
+        }
+        tests++;
+    }
+    for (n = VECTOR_MIN_SIZE; success && n <= MAX_SIZE; n++) {
+        if (!testVectorMoves(n)) {
+            printf("%ux%u %s move mismatch\n", n, n, initVectorKernels());
+            success = false;
+        }
+        tests++;
+    }
+    if (success && !testBatch()) {
+        printf("batch mismatch\n");
+        success = false;
+    }
+    tests++;
+    for (n = MIN_SIZE; success && n <= MAX_SIZE; n++) {
+        if (!testMasks(n)) {
+            printf("%ux%u empty mask mismatch\n", n, n);
+            success = false;
+        }
+        tests++;
+    }
+    if (success && !verifyRows()) {
+        success = false;
+    }
+    tests++;
+    // short games keep the test fast, ./2048 verify plays them to the end
+    for (n = MIN_SIZE; success && n <= MAX_SIZE; n++) {
+        if (!verifyGames(n, 10, 1, 500, &moves)) {
+            success = false;
+        }
+        tests++;
+    }
+    if (success && !testSymmetry()) {
+        printf("symmetry mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testStats()) {
+        printf("statistics mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testReplay()) {
+        printf("replay record mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testHistory()) {
+        printf("undo history mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testRollouts()) {
+        printf("rollout pool mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testTuples()) {
+        printf("n-tuple mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testServe()) {
+        printf("session server mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testTablebase()) {
+        printf("tablebase mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testAnalysis()) {
+        printf("background analysis mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success && !testAnalytics()) {
+        printf("analytics mismatch\n");
+        success = false;
+    }
+    tests++;
+    if (success) {
+        printf("All %u tests executed successfully\n", tests);
+    }
+    return !success;
+}
+
+static volatile sig_atomic_t terminateRequested = 0;
+
+/**
+ * @brief                       Ctrl-C 를 받으면 플래그만 세운다. 이벤트 루프가 게임을 끝내고 main 이 터미널을 되돌린다.
+ * @remark                      printf 나 exit 는 시그널 핸들러에서 안전하지 않다.
+ */
+void signal_callback_handler(int signum)
+{
+    (void) signum;
+    terminateRequested = 1;
+}
+
+
+
+/**
+ * @brief 게임별 분석 기록 (columnar) 상수입니다
+ * @remark 게임 한 판이 한 행이고, 파일은 블럭을 이어 붙인 것이라 여러 번 실행한 결과를 계속 덧붙이거나
+ *         파일끼리 이어 붙일 수 있다. 블럭 하나는 ANALYTICS_BLOCK_ROWS 행 이하이며,
+ *         헤더 ("2048COLS", 버전 (4), 열 수 (4), 행 수 (4), 게임판 크기 (4), 블럭 전체 길이 (8)),
+ *         열마다 블럭 안의 최소값 (8) 과 최대값 (8), 그리고 열마다 행 수만큼의 고정 폭 값 배열이 이어진다.
+ *         열 배열은 8바이트 단위로 맞춘다. 헤더의 정수는 little endian, 열의 값은 실행하는 CPU 의 형식 그대로이다.
+ *         열: seed (8, 새 블럭 난수 상태), moves (4), score (4), 최대 블럭 지수 (1),
+ *         지수 1 ~ ANALYTICS_TILES 블럭이 처음 나타났을 때까지의 이동 수 (각 4, 없으면 ANALYTICS_NEVER),
+ *         지수 1 ~ ANALYTICS_TILES 블럭을 merge 로 만든 횟수 (각 4, 마지막 열은 그 이상도 포함)
+ *         처음 나타난 이동 수 열의 최소값과 최대값은 ANALYTICS_NEVER 를 빼고 구하므로, 블럭 안에 그 블럭을
+ *         만든 게임이 없으면 최소값이 최대값보다 크다.
+ */
+#define ANALYTICS_MAGIC              "2048COLS"
+#define ANALYTICS_VERSION            1
+#define ANALYTICS_TILES              16
+#define ANALYTICS_SEED               0
+#define ANALYTICS_MOVES              1
+#define ANALYTICS_SCORE              2
+#define ANALYTICS_MAX_TILE           3
+#define ANALYTICS_REACHED            4
+#define ANALYTICS_MERGES             (ANALYTICS_REACHED + ANALYTICS_TILES)
+#define ANALYTICS_COLUMNS            (ANALYTICS_MERGES + ANALYTICS_TILES)
+#define ANALYTICS_HEADER_SIZE        32
+#define ANALYTICS_BLOCK_HEADER_SIZE  (ANALYTICS_HEADER_SIZE + 16 * ANALYTICS_COLUMNS)
+#define ANALYTICS_BLOCK_ROWS         16384
+#define ANALYTICS_NEVER              UINT32_MAX
+
+/**
+ * @brief                       게임 한 판의 분석 기록, 파일의 한 행
+ * @param reached               reached[e - 1] 은 지수 e 블럭이 처음 나타났을 때까지 한 이동 수
+ * @param merges                merges[e - 1] 은 merge 로 지수 e 블럭을 만든 횟수
+ */
+typedef struct {
+    uint64_t seed;
+    uint32_t moves;
+    uint32_t score;
+    uint8_t maxTile;
+    uint32_t reached[ANALYTICS_TILES];
+    uint32_t merges[ANALYTICS_TILES];
+} GameAnalytics;
+
+/**
+ * @brief                       스레드 하나가 채우는 블럭
+ * @remark                      열마다 ANALYTICS_BLOCK_ROWS 행의 배열을 미리 할당하고, 블럭이 차면 헤더와 열 배열을
+ *                              writev 로 O_APPEND 파일에 쓴다. 짧게 쓰여서 나머지를 다시 쓰는 동안 다른 스레드의
+ *                              블럭이 끼어들지 않도록 블럭 하나를 쓰는 동안 analyticsLock 을 잡는다.
+ * @param columns               열마다의 값 배열
+ * @param min                   열마다 블럭 안의 최소값
+ * @param max                   열마다 블럭 안의 최대값
+ * @param failed                쓰기에 실패했으면 true, 이후 행은 버린다.
+ */
+typedef struct {
+    uint8_t *columns[ANALYTICS_COLUMNS];
+    uint64_t min[ANALYTICS_COLUMNS];
+    uint64_t max[ANALYTICS_COLUMNS];
+    unsigned int rows;
+    unsigned int size;
+    int fd;
+    bool failed;
+} AnalyticsWriter;
+
+/**
+ * @brief                       파일에서 읽은 블럭 하나, columns 는 mmap 한 영역을 가리킨다.
+ */
+typedef struct {
+    const uint8_t *columns[ANALYTICS_COLUMNS];
+    uint64_t min[ANALYTICS_COLUMNS];
+    uint64_t max[ANALYTICS_COLUMNS];
+    unsigned int rows;
+    unsigned int size;
+} AnalyticsBlock;
+
+static pthread_mutex_t analyticsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief                       열의 값 하나가 차지하는 바이트 수
+ */
+static unsigned int analyticsWidth(unsigned int column)
+{
+    return column == ANALYTICS_SEED ? 8 : column == ANALYTICS_MAX_TILE ? 1 : 4;
+}
+
+/**
+ * @brief                       rows 행인 열 하나의 (8바이트 단위로 맞춘) 길이
+ */
+static size_t analyticsColumnLength(unsigned int column, unsigned int rows)
+{
+    return ((size_t) rows * analyticsWidth(column) + 7) & ~(size_t) 7;
+}
+
+static void resetAnalyticsBlock(AnalyticsWriter *writer)
+{
+    unsigned int c;
+
+    writer->rows = 0;
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        writer->min[c] = UINT64_MAX;
+        writer->max[c] = 0;
+    }
+}
+
+/**
+ * @brief                       분석 기록을 덧붙일 준비를 한다.
+ * @param int fd                O_APPEND 로 연 파일, 여러 writer 가 함께 써도 된다.
+ * @param unsigned int size     게임판 크기
+ * @return bool                 메모리가 부족하면 false
+ */
+bool initAnalyticsWriter(AnalyticsWriter *writer, int fd, unsigned int size)
+{
+    unsigned int c;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = fd;
+    writer->size = size;
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        // zeroed, so the padding of a short block is written as zeros
+        writer->columns[c] = calloc(1, analyticsColumnLength(c, ANALYTICS_BLOCK_ROWS));
+        if (writer->columns[c] == NULL) {
+            return false;
+        }
+    }
+    resetAnalyticsBlock(writer);
+    return true;
+}
+
+/**
+ * @brief                       채운 행들을 블럭 하나로 파일에 쓴다.
+ * @return bool                 쓸 수 없으면 false
+ */
+bool flushAnalytics(AnalyticsWriter *writer)
+{
+    uint8_t header[ANALYTICS_BLOCK_HEADER_SIZE];
+    struct iovec parts[1 + ANALYTICS_COLUMNS];
+    struct iovec *part = parts;
+    unsigned int count = 1 + ANALYTICS_COLUMNS;
+    size_t length = sizeof(header);
+    ssize_t written;
+    unsigned int c;
+
+    if (writer->rows == 0 || writer->failed) {
+        return !writer->failed;
+    }
+    parts[0].iov_base = header;
+    parts[0].iov_len = sizeof(header);
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        putLittleEndian(header + ANALYTICS_HEADER_SIZE + 16 * c, writer->min[c], 8);
+        putLittleEndian(header + ANALYTICS_HEADER_SIZE + 16 * c + 8, writer->max[c], 8);
+        parts[1 + c].iov_base = writer->columns[c];
+        parts[1 + c].iov_len = analyticsColumnLength(c, writer->rows);
+        length += parts[1 + c].iov_len;
+    }
+    memset(header, 0, ANALYTICS_HEADER_SIZE);
+    memcpy(header, ANALYTICS_MAGIC, 8);
+    putLittleEndian(header + 8, ANALYTICS_VERSION, 4);
+    putLittleEndian(header + 12, ANALYTICS_COLUMNS, 4);
+    putLittleEndian(header + 16, writer->rows, 4);
+    putLittleEndian(header + 20, writer->size, 4);
+    putLittleEndian(header + 24, length, 8);
+
+    // a regular file takes the whole block at once, the loop only matters for a short write,
+    // and the lock keeps the rest of the block ahead of the other threads' blocks
+    pthread_mutex_lock(&analyticsLock);
+    while (count > 0) {
+        written = writev(writer->fd, part, count);
+        if (written <= 0) {
+            pthread_mutex_unlock(&analyticsLock);
+            writer->failed = true;
+            return false;
+        }
+        while (count > 0 && (size_t) written >= part->iov_len) {
+            written -= part->iov_len;
+            part++;
+            count--;
+        }
+        if (count > 0) {
+            part->iov_base = (uint8_t *) part->iov_base + written;
+            part->iov_len -= written;
+        }
+    }
+    pthread_mutex_unlock(&analyticsLock);
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        // clear the tail so the next short block pads with zeros again
+        memset(writer->columns[c], 0, analyticsColumnLength(c, writer->rows));
+    }
+    resetAnalyticsBlock(writer);
+    return true;
+}
+
+/**
+ * @brief                       남은 행을 쓰고 열 배열을 해제한다. 파일은 닫지 않는다.
+ * @return bool                 쓰기에 실패한 적이 있으면 false
+ */
+bool freeAnalyticsWriter(AnalyticsWriter *writer)
+{
+    bool success = flushAnalytics(writer);
+    unsigned int c;
+
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        free(writer->columns[c]);
+        writer->columns[c] = NULL;
+    }
+    return success;
+}
+
+static ALWAYS_INLINE void putAnalyticsValue(AnalyticsWriter *writer, unsigned int column, uint64_t value, bool counted)
+{
+    const unsigned int width = analyticsWidth(column);
+    uint8_t *p = writer->columns[column] + (size_t) writer->rows * width;
+
+    if (width == 8) {
+        memcpy(p, &value, 8);
+    } else if (width == 4) {
+        *(uint32_t *) p = (uint32_t) value;
+    } else {
+        *p = (uint8_t) value;
+    }
+    if (counted) {
+        writer->min[column] = value < writer->min[column] ? value : writer->min[column];
+        writer->max[column] = value > writer->max[column] ? value : writer->max[column];
+    }
+}
+
+/**
+ * @brief                       게임 한 판의 기록을 한 행으로 덧붙이고, 블럭이 차면 파일에 쓴다.
+ */
+void appendAnalytics(AnalyticsWriter *writer, const GameAnalytics *game)
+{
+    unsigned int i;
+
+    if (writer->failed) {
+        return;
+    }
+    putAnalyticsValue(writer, ANALYTICS_SEED, game->seed, true);
+    putAnalyticsValue(writer, ANALYTICS_MOVES, game->moves, true);
+    putAnalyticsValue(writer, ANALYTICS_SCORE, game->score, true);
+    putAnalyticsValue(writer, ANALYTICS_MAX_TILE, game->maxTile, true);
+    for (i = 0; i < ANALYTICS_TILES; i++) {
+        putAnalyticsValue(writer, ANALYTICS_REACHED + i, game->reached[i], game->reached[i] != ANALYTICS_NEVER);
+        putAnalyticsValue(writer, ANALYTICS_MERGES + i, game->merges[i], true);
+    }
+    if (++writer->rows == ANALYTICS_BLOCK_ROWS) {
+        flushAnalytics(writer);
+    }
+}
+
+/**
+ * @brief                       새 게임의 기록을 시작한다.
+ * @param uint64_t seed         처음 두 블럭을 추가하기 전의 새 블럭 난수 상태
+ */
+void startAnalytics(GameAnalytics *game, uint64_t seed)
+{
+    unsigned int i;
+
+    memset(game, 0, sizeof(*game));
+    game->seed = seed;
+    for (i = 0; i < ANALYTICS_TILES; i++) {
+        game->reached[i] = ANALYTICS_NEVER;
+    }
+}
+
+/**
+ * @brief                       지수 value 블럭이 moves 번째 이동에서 나타났음을 기록한다.
+ */
+static ALWAYS_INLINE void noteTile(GameAnalytics *game, unsigned int value, uint32_t moves)
+{
+    if (value > 0 && value <= ANALYTICS_TILES && game->reached[value - 1] == ANALYTICS_NEVER) {
+        game->reached[value - 1] = moves;
+    }
+}
+
+/**
+ * @brief                       merge 로 지수 value 블럭을 만들었음을 기록한다.
+ */
+static ALWAYS_INLINE void noteMerge(GameAnalytics *game, unsigned int value, uint32_t moves)
+{
+    game->merges[(value <= ANALYTICS_TILES ? value : ANALYTICS_TILES) - 1]++;
+    noteTile(game, value, moves);
+}
+
+/**
+ * @brief                       board_t 의 블럭들이 나타났음을 기록한다. (처음 게임판)
+ */
+static void noteBoard(GameAnalytics *game, board_t b, uint32_t moves)
+{
+    for (; b != 0; b >>= 4) {
+        noteTile(game, b & 0xF, moves);
+    }
+}
+
+/**
+ * @brief                       board_t 를 direction 으로 이동할 때의 merge 들을 기록한다.
+ * @remark                      merge 는 방향과 상관없이 행마다 같으므로 위/아래는 그대로, 왼쪽/오른쪽은
+ *                              전치한 게임판의 행으로 rowMergeTable 을 찾는다.
+ * @param uint32_t moves        이 이동까지의 이동 수
+ */
+static void notePackedMove(GameAnalytics *game, board_t b, unsigned int direction, uint32_t moves)
+{
+    unsigned int i, made;
+
+    if (direction == MOVE_LEFT || direction == MOVE_RIGHT) {
+        b = transposeBoard(b);
+    }
+    for (i = 0; i < SIZE; i++) {
+        for (made = rowMergeTable[(b >> (16 * i)) & ROW_MASK]; made != 0; made >>= 8) {
+            noteMerge(game, made & 0xFF, moves);
+        }
+    }
+}
+
+
+/**
+ * @brief 시뮬레이션에서 다음 이동 방향을 고르는 정책 상수입니다
+ */
+#define POLICY_RANDOM                0
+#define POLICY_ORDER                 1
+#define POLICY_GREEDY                2
+
+typedef struct {
+    unsigned long games;
+    unsigned int policy;
+    unsigned int order[MOVE_COUNT];
+    unsigned int threads;
+    unsigned int size;
+    uint64_t seed;
+    const char *record;
+    const char *analytics;
+} SimOptions;
+
+typedef struct {
+    unsigned long games;
+    unsigned long long moves;
+    unsigned int *scores;
+    unsigned long tiles[TILE_LEVELS];
+} SimStats;
+
+/**
+ * @brief                       시뮬레이션 스레드 하나의 작업과 결과
+ * @remark                      각 스레드는 자기 난수 상태와 통계만 수정하고, scores 는 전체 결과 배열에서
+ *                              자기 구간만 사용하므로 실행 중에는 잠금이 필요 없다.
+ *                              padding 은 이웃한 스레드의 카운터가 같은 캐시 라인에 놓이지 않게 한다.
+ */
+typedef struct {
+    const SimOptions *options;
+    unsigned long count;
+    uint64_t rng;
+    SimStats stats;
+    Replay replay;
+    Buffer records;
+    AnalyticsWriter analytics;
+    pthread_t thread;
+    bool started;
+    char padding[64];
+} SimWorker;
+
+/**
+ * @brief                       정책에 따라 가능한 방향 중 하나를 고른다.
+ * @param unsigned int legal    움직일 수 있는 방향들, options->order 순서
+ * @param unsigned int count    legal 의 개수 (1 이상)
+ * @param unsigned int scores   방향별로 얻는 점수
+ * @return unsigned int         선택한 방향
+ */
+unsigned int pickPolicyMove(const SimOptions *options, const unsigned int legal[MOVE_COUNT], unsigned int count,
+                            const unsigned int scores[MOVE_COUNT], uint64_t *rng)
+{
+    unsigned int best = legal[0];
+    unsigned int i;
+
+    switch (options->policy) {
+        case POLICY_RANDOM:
+            best = legal[randomBelow(rng, count)];
+            break;
+        case POLICY_GREEDY:
+            for (i = 1; i < count; i++) {
+                if (scores[legal[i]] > scores[best]) {
+                    best = legal[i];
+                }
+            }
+            break;
+    }
+    return best;
+}
+
+/**
+ * @brief                       정책에 따라 다음 이동 방향을 고른다.
+ * @param SimOptions options    시뮬레이션 옵션
+ * @param board_t b             현재 게임판
+ * @param uint64_t rng          난수 상태
+ * @param board_t next          선택한 방향으로 이동한 게임판을 저장할 변수
+ * @param unsigned int gained   선택한 이동으로 얻는 점수를 저장할 변수
+ * @return int                  선택한 방향, 움직일 수 있는 방향이 없으면 -1
+ */
+int choosePolicyMove(const SimOptions *options, board_t b, uint64_t *rng, board_t *next, unsigned int *gained)
+{
+    board_t moved[MOVE_COUNT];
+    unsigned int scores[MOVE_COUNT];
+    unsigned int legal[MOVE_COUNT];
+    unsigned int count = 0;
+    unsigned int i, d;
+    unsigned int best;
+
+    for (i = 0; i < MOVE_COUNT; i++) {
+        d = options->order[i];
+        scores[d] = 0;
+        moved[d] = packedMove(b, d, &scores[d]);
+        if (moved[d] != b) {
+            legal[count++] = d;
+        }
+    }
+    if (count == 0) {
+        return -1;
+    }
+    best = pickPolicyMove(options, legal, count, scores, rng);
+    *next = moved[best];
+    *gained = scores[best];
+    return best;
+}
+
+/**
+ * @brief                       배열 게임판의 블럭 수를 지수마다 counts 에 sign 만큼 더한다.
+ */
+static void countArrayTiles(const Game *game, int counts[TILE_LEVELS], int sign)
+{
+    unsigned int x, y;
+
+    for (x = 0; x < game->size; x++) {
+        for (y = 0; y < game->size; y++) {
+            counts[game->board[x][y] < TILE_LEVELS ? game->board[x][y] : TILE_LEVELS - 1] += sign;
+        }
+    }
+}
+
+/**
+ * @brief                       배열 게임판의 블럭들이 나타났음을 기록한다.
+ */
+static void noteArrayBoard(GameAnalytics *summary, const Game *game, uint32_t moves)
+{
+    unsigned int x, y;
+
+    for (x = 0; x < game->size; x++) {
+        for (y = 0; y < game->size; y++) {
+            noteTile(summary, game->board[x][y], moves);
+        }
+    }
+}
+
+/**
+ * @brief                       화면 출력 없이 게임 한 판을 끝까지 진행한다.
+ * @param SimOptions options    시뮬레이션 옵션
+ * @param SimStats stats        결과를 누적할 통계
+ * @param uint64_t rng          난수 상태, 정책이 사용하고 게임마다 새 블럭용 난수 상태를 만든다.
+ * @param Replay replay         리플레이 기록, 기록하지 않으면 NULL
+ * @param Buffer records        기록이 끝난 게임을 덧붙일 버퍼
+ * @param AnalyticsWriter analytics 게임별 분석 기록, 기록하지 않으면 NULL
+ */
+void simulateGame(const SimOptions *options, SimStats *stats, uint64_t *rng, Replay *replay, Buffer *records,
+                  AnalyticsWriter *analytics)
+{
+    // spawns use their own stream so that a replay does not depend on the policy
+    uint64_t spawn = seedRandom(nextRandom64(rng), 0);
+    GameAnalytics summary;
+    board_t b;
+    board_t next;
+    board_t spawned;
+    unsigned int gained;
+    unsigned int total = 0;
+    uint32_t moves = 0;
+    int d;
+
+    if (replay != NULL) {
+        startReplay(replay, spawn, SIZE);
+    }
+    if (analytics != NULL) {
+        startAnalytics(&summary, spawn);
+    }
+    b = packedAddRandom(packedAddRandom(0, &spawn), &spawn);
+    if (analytics != NULL) {
+        noteBoard(&summary, b, 0);
+    }
+    while ((d = choosePolicyMove(options, b, rng, &next, &gained)) >= 0) {
+        if (analytics != NULL) {
+            notePackedMove(&summary, b, d, moves + 1);
+        }
+        total += gained;
+        b = packedAddRandom(next, &spawn);
+        stats->moves++;
+        moves++;
+        if (replay != NULL) {
+            recordMove(replay, d);
+            recordBoard(replay, b);
+        }
+        if (analytics != NULL) {
+            // a legal move always leaves an empty cell, so exactly one nibble changed
+            spawned = b ^ next;
+            noteTile(&summary, (spawned >> (__builtin_ctzll(spawned) & ~3u)) & 0xF, moves);
+        }
+    }
+    stats->scores[stats->games++] = total;
+    stats->tiles[packedMaxTile(b)]++;
+    if (replay != NULL) {
+        encodeReplay(replay, b, total, records);
+    }
+    if (analytics != NULL) {
+        summary.moves = moves;
+        summary.score = total;
+        summary.maxTile = packedMaxTile(b);
+        appendAnalytics(analytics, &summary);
+    }
+}
+
+/**
+ * @brief                       4x4 가 아닌 게임판으로 게임 한 판을 끝까지 진행한다.
+ * @remark                      board_t 에 들어가지 않는 크기이므로 크기별로 특수화된 배열 함수를 사용한다.
+ *                              방향마다 scratch 에 게임판을 복사해서 움직여 보고 정책으로 하나를 고른다.
+ * @param Game game             진행할 게임, 크기는 options->size 로 정해져 있어야 한다.
+ * @param Game scratch          같은 크기의 작업용 게임
+ * @remark                      분석 기록의 merge 는 이동 전후의 블럭 수 차이로 countMerges 가 구한다.
+ */
+void simulateArrayGame(const SimOptions *options, SimStats *stats, uint64_t *rng, Replay *replay, Buffer *records,
+                       AnalyticsWriter *analytics, Game *game, Game *scratch)
+{
+    GameAnalytics summary;
+    int change[TILE_LEVELS];
+    unsigned int made[TILE_LEVELS];
+    unsigned int scores[MOVE_COUNT];
+    unsigned int legal[MOVE_COUNT];
+    unsigned int count;
+    unsigned int i, d, x, y, e;
+    unsigned int max = 0;
+    uint32_t moves = 0;
+
+    game->rng = seedRandom(nextRandom64(rng), 0);
+    if (replay != NULL) {
+        startReplay(replay, game->rng, game->size);
+    }
+    if (analytics != NULL) {
+        startAnalytics(&summary, game->rng);
+    }
+    memset(game->board, 0, sizeof(game->board));
+    refreshMasks(game);
+    game->score = 0;
+    addRandom(game);
+    addRandom(game);
+    if (analytics != NULL) {
+        noteArrayBoard(&summary, game, 0);
+    }
+    for (;;) {
+        count = 0;
+        for (i = 0; i < MOVE_COUNT; i++) {
+            d = options->order[i];
+            memcpy(scratch->board, game->board, sizeof(game->board));
+            scratch->score = 0;
+            if (scratch->kernels->move[d](scratch)) {
+                scores[d] = scratch->score;
+                legal[count++] = d;
+            }
+        }
+        if (count == 0) {
+            break;
+        }
+        d = pickPolicyMove(options, legal, count, scores, rng);
+        if (analytics != NULL) {
+            memset(change, 0, sizeof(change));
+            countArrayTiles(game, change, -1);
+        }
+        game->kernels->move[d](game);
+        moves++;
+        if (analytics != NULL) {
+            countArrayTiles(game, change, 1);
+            memset(made, 0, sizeof(made));
+            countMerges(change, made);
+            for (e = 1; e < TILE_LEVELS; e++) {
+                for (i = 0; i < made[e]; i++) {
+                    noteMerge(&summary, e, moves);
+                }
+            }
+        }
+        addRandom(game);
+        stats->moves++;
+        if (replay != NULL) {
+            recordMove(replay, d);
+            recordBoard(replay, boardDigest(game));
+        }
+        if (analytics != NULL) {
+            noteArrayBoard(&summary, game, moves);
+        }
+    }
+    for (x = 0; x < game->size; x++) {
+        for (y = 0; y < game->size; y++) {
+            if (game->board[x][y] > max) {
+                max = game->board[x][y];
+            }
+        }
+    }
+    stats->scores[stats->games++] = game->score;
+    stats->tiles[max < TILE_LEVELS ? max : TILE_LEVELS - 1]++;
+    if (replay != NULL) {
+        encodeReplay(replay, boardDigest(game), game->score, records);
+    }
+    if (analytics != NULL) {
+        summary.moves = moves;
+        summary.score = game->score;
+        summary.maxTile = max < UINT8_MAX ? max : UINT8_MAX;
+        appendAnalytics(analytics, &summary);
+    }
+}
+
+void *simulateWorker(void *arg)
+{
+    SimWorker *worker = arg;
+    Replay *replay = worker->options->record != NULL ? &worker->replay : NULL;
+    AnalyticsWriter *analytics = worker->options->analytics != NULL ? &worker->analytics : NULL;
+    Game game;
+    Game scratch;
+    unsigned long i;
+
+    setBoardSize(&game, worker->options->size);
+    setBoardSize(&scratch, worker->options->size);
+    for (i = 0; i < worker->count; i++) {
+        if (worker->options->size == SIZE) {
+            simulateGame(worker->options, &worker->stats, &worker->rng, replay, &worker->records, analytics);
+        } else {
+            simulateArrayGame(worker->options, &worker->stats, &worker->rng, replay, &worker->records, analytics,
+                              &game, &scratch);
+        }
+    }
+    return NULL;
+}
+
+int compareScores(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+    return (x > y) - (x < y);
+}
+
+void printSimStats(SimStats *stats, double seconds)
+{
+    unsigned long long sum = 0;
+    unsigned long i, n = stats->games;
+    unsigned int *s = stats->scores;
+
+    qsort(s, n, sizeof(s[0]), compareScores);
+    for (i = 0; i < n; i++) {
+        sum += s[i];
+    }
+    printf("games      %lu\n", n);
+    printf("moves      %llu\n", stats->moves);
+    printf("time       %.3f s\n", seconds);
+    printf("games/sec  %.1f\n", n / seconds);
+    printf("moves/sec  %.1f\n", stats->moves / seconds);
+    printf("score      min %u  mean %.1f  p50 %u  p90 %u  p99 %u  max %u\n",
+           s[0], (double) sum / n, s[n / 2], s[n * 9 / 10], s[n * 99 / 100], s[n - 1]);
+    printf("max tile\n");
+    for (i = 0; i < TILE_LEVELS; i++) {
+        if (stats->tiles[i] > 0) {
+            printf("  %6u  %10lu  %6.2f%%\n", 1u << i, stats->tiles[i], 100.0 * stats->tiles[i] / n);
+        }
+    }
+}
+
+/**
+ * @brief                       시뮬레이션 옵션을 해석한다.
+ *                              --games N, --policy random|order|greedy, --order ULDR, --seed N, --threads N,
+ *                              --size N, --record FILE, --analytics FILE
+ * @return bool                 잘못된 옵션이 있으면 false
+ */
+bool parseSimOptions(int argc, char *argv[], SimOptions *options)
+{
+    const char *dirs = "udlr";
+    const char *p;
+    int i;
+    unsigned int d;
+
+    options->games = 1000;
+    options->policy = POLICY_RANDOM;
+    options->seed = time(NULL);
+    options->threads = onlineProcessors();
+    options->size = SIZE;
+    options->record = NULL;
+    options->analytics = NULL;
+    for (d = 0; d < MOVE_COUNT; d++) {
+        options->order[d] = d;
+    }
+    for (i = 0; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        if (strcmp(argv[i], "--games") == 0) {
+            options->games = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--record") == 0) {
+            options->record = argv[++i];
+        } else if (strcmp(argv[i], "--analytics") == 0) {
+            options->analytics = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            options->threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--size") == 0) {
+            options->size = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--policy") == 0) {
+            i++;
+            if (strcmp(argv[i], "random") == 0) {
+                options->policy = POLICY_RANDOM;
+            } else if (strcmp(argv[i], "order") == 0) {
+                options->policy = POLICY_ORDER;
+            } else if (strcmp(argv[i], "greedy") == 0) {
+                options->policy = POLICY_GREEDY;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--order") == 0) {
+            i++;
+            if (strlen(argv[i]) != MOVE_COUNT) {
+                return false;
+            }
+            for (d = 0; d < MOVE_COUNT; d++) {
+                p = strchr(dirs, argv[i][d] | 0x20);
+                if (p == NULL) {
+                    return false;
+                }
+                options->order[d] = p - dirs;
+            }
+        } else {
+            return false;
+        }
+    }
+    if (options->threads == 0) {
+        options->threads = 1;
+    }
+    return options->games > 0 && options->size >= MIN_SIZE && options->size <= MAX_SIZE;
+}
+
+/**
+ * @brief                       화면 출력과 대기 없이 여러 게임을 진행하고 통계를 출력한다.
+ * @remark                      게임은 스레드 수로 고르게 나누어지고, 스레드 t 는 seedRandom(seed, t) 의
+ *                              난수열을 사용하므로 같은 seed 와 스레드 수에서는 결과가 항상 같다.
+ *                              스레드별 통계는 모든 스레드가 끝난 뒤에 합친다.
+ *                              --analytics 의 블럭은 스레드마다 차는 순서대로 파일에 덧붙으므로 행의 순서는
+ *                              실행마다 다를 수 있지만 행의 집합은 같다.
+ * @param int argc              "sim" 이후 실행 파라미터의 개수
+ * @param int argv              "sim" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int simulate(int argc, char *argv[])
+{
+    SimOptions options;
+    SimStats stats;
+    SimWorker *workers;
+    struct timespec start;
+    FILE *record = NULL;
+    unsigned long first = 0;
+    unsigned int t, i;
+    bool success = true;
+    int analytics = -1;
+
+    if (!parseSimOptions(argc, argv, &options)) {
+        fprintf(stderr, "usage: 2048 sim [--games N] [--policy random|order|greedy] [--order ULDR] [--seed N] [--threads N] [--size N] [--record FILE] [--analytics FILE]\n");
+        return EXIT_FAILURE;
+    }
+    memset(&stats, 0, sizeof(stats));
+    stats.scores = malloc(options.games * sizeof(stats.scores[0]));
+    workers = calloc(options.threads, sizeof(workers[0]));
+    if (stats.scores == NULL || workers == NULL) {
+        fprintf(stderr, "cannot allocate %lu games\n", options.games);
+        free(stats.scores);
+        free(workers);
+        return EXIT_FAILURE;
+    }
+    if (options.record != NULL && (record = fopen(options.record, "ab")) == NULL) {
+        fprintf(stderr, "cannot record to %s\n", options.record);
+        free(stats.scores);
+        free(workers);
+        return EXIT_FAILURE;
+    }
+    if (options.analytics != NULL) {
+        analytics = open(options.analytics, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        for (t = 0; t < options.threads && analytics >= 0; t++) {
+            success &= initAnalyticsWriter(&workers[t].analytics, analytics, options.size);
+        }
+        if (analytics < 0 || !success) {
+            fprintf(stderr, "cannot write analytics to %s\n", options.analytics);
+            for (t = 0; t < options.threads; t++) {
+                freeAnalyticsWriter(&workers[t].analytics);
+            }
+            if (analytics >= 0) {
+                close(analytics);
+            }
+            if (record != NULL) {
+                fclose(record);
+            }
+            free(stats.scores);
+            free(workers);
+            return EXIT_FAILURE;
+        }
+    }
+    initMoveTables();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (t = 0; t < options.threads; t++) {
+        workers[t].options = &options;
+        workers[t].count = options.games * (t + 1) / options.threads - first;
+        workers[t].rng = seedRandom(options.seed, t);
+        workers[t].stats.scores = stats.scores + first;
+        first += workers[t].count;
+        // the first share runs on this thread
+        workers[t].started = t > 0 && pthread_create(&workers[t].thread, NULL, simulateWorker, &workers[t]) == 0;
+    }
+    for (t = 0; t < options.threads; t++) {
+        if (workers[t].started) {
+            pthread_join(workers[t].thread, NULL);
+        } else {
+            simulateWorker(&workers[t]);
+        }
+        stats.games += workers[t].stats.games;
+        stats.moves += workers[t].stats.moves;
+        for (i = 0; i < TILE_LEVELS; i++) {
+            stats.tiles[i] += workers[t].stats.tiles[i];
+        }
+    }
+    printSimStats(&stats, elapsedSeconds(&start));
+    for (t = 0; t < options.threads; t++) {
+        // records are written in thread order, so the file is the same for the same seed
+        if (record != NULL) {
+            fwrite(workers[t].records.data, 1, workers[t].records.length, record);
+        }
+        freeBuffer(&workers[t].records);
+        freeBuffer(&workers[t].replay.moves);
+        if (analytics >= 0) {
+            success &= freeAnalyticsWriter(&workers[t].analytics);
+        }
+    }
+    if (record != NULL) {
+        fclose(record);
+    }
+    if (analytics >= 0) {
+        close(analytics);
+        if (!success) {
+            fprintf(stderr, "cannot write analytics to %s\n", options.analytics);
+        }
+    }
+    free(stats.scores);
+    free(workers);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief 분석 기록 통계 상수입니다
+ * @remark 백분위수는 최소값부터 최대값까지를 ANALYTICS_BUCKETS 개의 같은 폭 구간으로 나눈 히스토그램에서 구하므로,
+ *         값의 범위가 구간 수보다 작으면 정확하고 크면 구간 폭만큼의 오차가 있다.
+ *         최소값과 최대값은 블럭 헤더만 읽어서 구하므로 히스토그램은 파일을 한 번만 훑는다.
+ */
+#define ANALYTICS_BUCKETS            65536
+#define ANALYTICS_BAR_WIDTH          40
+#define ANALYTICS_SCORE_BARS         10
+
+/**
+ * @brief                       같은 폭 구간의 히스토그램
+ * @param base                  첫 구간의 시작 값
+ * @param low                   더한 값 중 최소값
+ * @param high                  더한 값 중 최대값
+ */
+typedef struct {
+    uint64_t base;
+    uint64_t width;
+    uint64_t low;
+    uint64_t high;
+    uint64_t count;
+    double sum;
+    uint64_t *counts;
+} Histogram;
+
+/**
+ * @brief                       offset 에 있는 블럭을 읽고 offset 을 다음 블럭으로 옮긴다.
+ * @remark                      헤더를 확인하고 열 배열의 위치만 계산하므로 값은 읽지 않는다.
+ * @return bool                 파일 끝이거나 블럭의 형식이 맞지 않으면 false (형식이 틀리면 offset 은 그대로)
+ */
+bool readAnalyticsBlock(const uint8_t *map, size_t length, size_t *offset, AnalyticsBlock *block)
+{
+    const uint8_t *p = map + *offset;
+    size_t size = ANALYTICS_BLOCK_HEADER_SIZE;
+    unsigned int c;
+
+    if (length - *offset < ANALYTICS_BLOCK_HEADER_SIZE || memcmp(p, ANALYTICS_MAGIC, 8) != 0
+        || getLittleEndian(p + 8, 4) != ANALYTICS_VERSION || getLittleEndian(p + 12, 4) != ANALYTICS_COLUMNS) {
+        return false;
+    }
+    block->rows = getLittleEndian(p + 16, 4);
+    block->size = getLittleEndian(p + 20, 4);
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        block->min[c] = getLittleEndian(p + ANALYTICS_HEADER_SIZE + 16 * c, 8);
+        block->max[c] = getLittleEndian(p + ANALYTICS_HEADER_SIZE + 16 * c + 8, 8);
+        block->columns[c] = p + size;
+        size += analyticsColumnLength(c, block->rows);
+    }
+    if (block->rows > ANALYTICS_BLOCK_ROWS || getLittleEndian(p + 24, 8) != size || length - *offset < size) {
+        return false;
+    }
+    *offset += size;
+    return true;
+}
+
+static bool initHistogram(Histogram *histogram, uint64_t min, uint64_t max)
+{
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->base = min;
+    histogram->low = UINT64_MAX;
+    histogram->width = min > max ? 1 : (max - min) / ANALYTICS_BUCKETS + 1;
+    histogram->counts = calloc(ANALYTICS_BUCKETS, sizeof(histogram->counts[0]));
+    return histogram->counts != NULL;
+}
+
+/**
+ * @brief                       값 하나를 히스토그램에 더한다.
+ * @return bool                 값이 initHistogram 의 범위 밖이면 (블럭이 손상되었으면) 더하지 않고 false
+ */
+static ALWAYS_INLINE bool addHistogram(Histogram *histogram, uint64_t value)
+{
+    uint64_t bucket = (value - histogram->base) / histogram->width;
+
+    if (value < histogram->base || bucket >= ANALYTICS_BUCKETS) {
+        return false;
+    }
+    histogram->counts[bucket]++;
+    histogram->low = value < histogram->low ? value : histogram->low;
+    histogram->high = value > histogram->high ? value : histogram->high;
+    histogram->count++;
+    histogram->sum += value;
+    return true;
+}
+
+/**
+ * @brief                       q 백분위수 (0 ~ 1) 가 들어 있는 구간의 시작 값
+ */
+static uint64_t histogramPercentile(const Histogram *histogram, double q)
+{
+    uint64_t rank = (uint64_t) (q * (histogram->count - 1));
+    uint64_t seen = 0;
+    unsigned int i;
+
+    for (i = 0; i < ANALYTICS_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen > rank) {
+            break;
+        }
+    }
+    return histogram->base + i * histogram->width;
+}
+
+static void printHistogramLine(const char *name, const Histogram *histogram)
+{
+    printf("%-10s min %llu  mean %.1f  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu", name,
+           (unsigned long long) histogram->low, histogram->sum / histogram->count,
+           (unsigned long long) histogramPercentile(histogram, 0.5),
+           (unsigned long long) histogramPercentile(histogram, 0.9),
+           (unsigned long long) histogramPercentile(histogram, 0.99),
+           (unsigned long long) histogramPercentile(histogram, 0.999), (unsigned long long) histogram->high);
+    if (histogram->width > 1) {
+        printf("  (buckets of %llu)", (unsigned long long) histogram->width);
+    }
+    printf("\n");
+}
+
+static void printBar(uint64_t count, uint64_t largest)
+{
+    unsigned int i, n = largest > 0 ? (unsigned int) (count * ANALYTICS_BAR_WIDTH / largest) : 0;
+
+    for (i = 0; i < n; i++) {
+        putchar('#');
+    }
+    putchar('\n');
+}
+
+/**
+ * @brief                       sim --analytics 로 만든 분석 기록 파일의 통계를 출력한다.
+ *                              --min-tile TILE (최대 블럭이 TILE 이상인 게임만)
+ * @remark                      파일을 mmap 해서 블럭 헤더로 범위를 구한 뒤 필요한 열만 한 번 훑는다.
+ *                              최대 블럭 열의 최대값이 TILE 보다 작은 블럭은 열을 읽지 않고 건너뛴다.
+ *                              점수와 이동 수의 분포, 최대 블럭의 히스토그램, 블럭마다 도달한 비율과
+ *                              처음 나타날 때까지의 이동 수, 게임당 merge 수를 출력한다.
+ * @param int argc              "stats" 이후 실행 파라미터의 개수
+ * @param int argv              "stats" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int summarizeAnalytics(int argc, char *argv[])
+{
+    const char *path = NULL;
+    // zeroed, so that the counts can be freed even when the first pass fails
+    Histogram score = {0}, moves = {0}, reached[ANALYTICS_TILES] = {{0}};
+    AnalyticsBlock block;
+    uint64_t tiles[TILE_LEVELS] = {0};
+    uint64_t merges[ANALYTICS_TILES] = {0};
+    uint64_t low[ANALYTICS_COLUMNS], high[ANALYTICS_COLUMNS];
+    uint64_t bars[ANALYTICS_SCORE_BARS] = {0};
+    uint64_t rows = 0, blocks = 0, largest, width;
+    uint8_t keep[ANALYTICS_BLOCK_ROWS];
+    unsigned int sizes = 0, minTile = 0, pass, c, i, r;
+    unsigned long tile;
+    struct stat info;
+    size_t offset, length;
+    uint8_t *map;
+    bool success = true;
+    bool valid = true;
+    int fd;
+
+    for (i = 0; i < (unsigned int) argc; i++) {
+        if (i + 1 < (unsigned int) argc && strcmp(argv[i], "--min-tile") == 0) {
+            tile = strtoul(argv[++i], NULL, 10);
+            for (minTile = 0; minTile < TILE_LEVELS && (1ul << minTile) < tile; minTile++) {
+            }
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: 2048 stats FILE [--min-tile TILE]\n");
+        return EXIT_FAILURE;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        fprintf(stderr, "cannot read %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return EXIT_FAILURE;
+    }
+    length = info.st_size;
+    map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "cannot map %s\n", path);
+        return EXIT_FAILURE;
+    }
+    posix_madvise(map, length, POSIX_MADV_SEQUENTIAL);
+
+    for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+        low[c] = UINT64_MAX;
+        high[c] = 0;
+    }
+    // the first pass reads only the block headers, the second one the columns
+    for (pass = 0; pass < 2 && success; pass++) {
+        for (offset = 0; readAnalyticsBlock(map, length, &offset, &block);) {
+            if (block.rows == 0 || block.max[ANALYTICS_MAX_TILE] < minTile) {
+                continue;
+            }
+            if (pass == 0) {
+                for (c = 0; c < ANALYTICS_COLUMNS; c++) {
+                    low[c] = block.min[c] < low[c] ? block.min[c] : low[c];
+                    high[c] = block.max[c] > high[c] && block.min[c] <= block.max[c] ? block.max[c] : high[c];
+                }
+                sizes |= 1u << (block.size < 32 ? block.size : 31);
+                blocks++;
+                continue;
+            }
+            for (r = 0; r < block.rows; r++) {
+                keep[r] = block.columns[ANALYTICS_MAX_TILE][r] >= minTile;
+                rows += keep[r];
+                tiles[block.columns[ANALYTICS_MAX_TILE][r] < TILE_LEVELS ? block.columns[ANALYTICS_MAX_TILE][r] : TILE_LEVELS - 1] += keep[r];
+            }
+            // the columns come from the file, so a value outside the header ranges marks a corrupt block
+            for (r = 0; r < block.rows; r++) {
+                if (keep[r]) {
+                    valid &= addHistogram(&score, ((const uint32_t *) block.columns[ANALYTICS_SCORE])[r]);
+                    valid &= addHistogram(&moves, ((const uint32_t *) block.columns[ANALYTICS_MOVES])[r]);
+                }
+            }
+            for (i = 0; i < ANALYTICS_TILES; i++) {
+                const uint32_t *first = (const uint32_t *) block.columns[ANALYTICS_REACHED + i];
+                const uint32_t *made = (const uint32_t *) block.columns[ANALYTICS_MERGES + i];
+                for (r = 0; r < block.rows; r++) {
+                    if (keep[r] && first[r] != ANALYTICS_NEVER) {
+                        valid &= addHistogram(&reached[i], first[r]);
+                    }
+                    merges[i] += keep[r] ? made[r] : 0;
+                }
+            }
+            if (!valid) {
+                fprintf(stderr, "%s: the block ending at byte %zu has values outside its range\n", path, offset);
+                success = false;
+                break;
+            }
+        }
+        if (!success) {
+            // the corrupt block was reported above
+        } else if (offset != length) {
+            fprintf(stderr, "%s: not an analytics block at byte %zu\n", path, offset);
+            success = false;
+        } else if (pass == 0 && blocks == 0) {
+            printf("no games\n");
+            munmap(map, length);
+            return EXIT_SUCCESS;
+        } else if (pass == 0) {
+            success &= initHistogram(&score, low[ANALYTICS_SCORE], high[ANALYTICS_SCORE]);
+            success &= initHistogram(&moves, low[ANALYTICS_MOVES], high[ANALYTICS_MOVES]);
+            for (i = 0; i < ANALYTICS_TILES; i++) {
+                success &= initHistogram(&reached[i], low[ANALYTICS_REACHED + i], high[ANALYTICS_REACHED + i]);
+            }
+            if (!success) {
+                fprintf(stderr, "cannot allocate the histograms\n");
+            }
+        }
+    }
+
+    if (success && rows > 0) {
+        printf("games      %llu in %llu blocks, board", (unsigned long long) rows, (unsigned long long) blocks);
+        for (i = MIN_SIZE; i <= MAX_SIZE; i++) {
+            if (sizes & (1u << i)) {
+                printf(" %ux%u", i, i);
+            }
+        }
+        printf("\n");
+        printHistogramLine("score", &score);
+        printHistogramLine("moves", &moves);
+
+        printf("score histogram\n");
+        width = (score.high - score.low) / ANALYTICS_SCORE_BARS + 1;
+        largest = 0;
+        for (r = 0; r < ANALYTICS_BUCKETS; r++) {
+            // the bucket holding the lowest score may start below it
+            if (score.counts[r] > 0) {
+                bars[score.base + r * score.width > score.low ? (score.base + r * score.width - score.low) / width : 0] += score.counts[r];
+            }
+        }
+        for (i = 0; i < ANALYTICS_SCORE_BARS; i++) {
+            largest = bars[i] > largest ? bars[i] : largest;
+        }
+        for (i = 0; i < ANALYTICS_SCORE_BARS; i++) {
+            printf("  %10llu  %10llu  ", (unsigned long long) (score.low + i * width), (unsigned long long) bars[i]);
+            printBar(bars[i], largest);
+        }
+        printf("max tile\n");
+        largest = 0;
+        for (i = 0; i < TILE_LEVELS; i++) {
+            largest = tiles[i] > largest ? tiles[i] : largest;
+        }
+        for (i = 0; i < TILE_LEVELS; i++) {
+            if (tiles[i] > 0) {
+                printf("  %10llu  %10llu  %6.2f%%  ", 1ull << i, (unsigned long long) tiles[i], 100.0 * tiles[i] / rows);
+                printBar(tiles[i], largest);
+            }
+        }
+        printf("tile        reached   p50 moves   p90 moves   merges/game\n");
+        for (i = 0; i < ANALYTICS_TILES; i++) {
+            if (reached[i].count > 0 || merges[i] > 0) {
+                printf("  %8llu  %6.2f%%  %10llu  %10llu  %12.2f\n", 1ull << (i + 1), 100.0 * reached[i].count / rows,
+                       (unsigned long long) histogramPercentile(&reached[i], 0.5),
+                       (unsigned long long) histogramPercentile(&reached[i], 0.9), (double) merges[i] / rows);
+            }
+        }
+    } else if (success) {
+        printf("no games with a %lu tile\n", 1ul << minTile);
+    }
+    free(score.counts);
+    free(moves.counts);
+    for (i = 0; i < ANALYTICS_TILES; i++) {
+        free(reached[i].counts);
+    }
+    munmap(map, length);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief                       4x4 와 5x5 게임의 분석 기록을 파일에 쓰고 다시 읽어서 확인한다.
+ * @return bool                 블럭과 행 수, 점수와 블럭 헤더의 범위가 맞고, 행마다 merge 로 만든 블럭의 합이
+ *                              점수와 같으며 처음 나타난 이동 수가 큰 블럭일수록 늦고 최대 블럭과 맞으며,
+ *                              끝에 쓰레기 바이트가 붙은 파일을 summarizeAnalytics 가 거부하면 true
+ */
+bool testAnalytics(void)
+{
+    const unsigned int counts[] = {25, 15, 20};
+    char path[] = "/tmp/2048-analytics-XXXXXX";
+    unsigned int scores[25 + 15 + 20];
+    AnalyticsWriter writer;
+    AnalyticsBlock block;
+    SimOptions options;
+    SimStats stats;
+    Game game, scratch;
+    struct stat info;
+    uint64_t rng = seedRandom(2048, 0);
+    uint64_t sum, low, high;
+    size_t offset = 0;
+    uint32_t reached[ANALYTICS_TILES];
+    uint32_t score;
+    uint8_t *map;
+    uint8_t trailing[18] = {0};
+    char *arguments[] = {path};
+    unsigned int b, r, i, k = 0, max;
+    bool success = true;
+    int fd, err, devnull;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    parseSimOptions(0, NULL, &options);
+    options.policy = POLICY_GREEDY;
+    memset(&stats, 0, sizeof(stats));
+    stats.scores = scores;
+    setBoardSize(&game, 5);
+    setBoardSize(&scratch, 5);
+    initMoveTables();
+    // two blocks from one 4x4 writer, then a 5x5 one
+    success &= initAnalyticsWriter(&writer, fd, SIZE);
+    for (i = 0; success && i < counts[0] + counts[1]; i++) {
+        simulateGame(&options, &stats, &rng, NULL, NULL, &writer);
+        if (i + 1 == counts[0]) {
+            success &= flushAnalytics(&writer);
+        }
+    }
+    success &= freeAnalyticsWriter(&writer);
+    success &= initAnalyticsWriter(&writer, fd, 5);
+    for (i = 0; success && i < counts[2]; i++) {
+        simulateArrayGame(&options, &stats, &rng, NULL, NULL, &writer, &game, &scratch);
+    }
+    success &= freeAnalyticsWriter(&writer);
+    if (!success || fstat(fd, &info) != 0
+        || (map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    close(fd);
+
+    for (b = 0; success && b < 3; b++) {
+        success = readAnalyticsBlock(map, info.st_size, &offset, &block) && block.rows == counts[b]
+                  && block.size == (b < 2 ? SIZE : 5);
+        low = UINT64_MAX;
+        high = 0;
+        for (r = 0; success && r < block.rows; r++, k++) {
+            score = ((const uint32_t *) block.columns[ANALYTICS_SCORE])[r];
+            max = block.columns[ANALYTICS_MAX_TILE][r];
+            sum = 0;
+            for (i = 0; i < ANALYTICS_TILES; i++) {
+                sum += (uint64_t) ((const uint32_t *) block.columns[ANALYTICS_MERGES + i])[r] << (i + 1);
+                reached[i] = ((const uint32_t *) block.columns[ANALYTICS_REACHED + i])[r];
+            }
+            // a 4 may spawn before any 2, from 8 on a tile needs the smaller one first
+            for (i = 2; i < ANALYTICS_TILES; i++) {
+                success &= reached[i] == ANALYTICS_NEVER || reached[i] >= reached[i - 1];
+            }
+            success &= score == scores[k] && sum == score && max > 0 && max < ANALYTICS_TILES
+                       && reached[max - 1] <= ((const uint32_t *) block.columns[ANALYTICS_MOVES])[r]
+                       && reached[max] == ANALYTICS_NEVER;
+            low = score < low ? score : low;
+            high = score > high ? score : high;
+        }
+        success &= block.min[ANALYTICS_SCORE] == low && block.max[ANALYTICS_SCORE] == high;
+    }
+    success &= offset == (size_t) info.st_size && !readAnalyticsBlock(map, info.st_size, &offset, &block);
+    munmap(map, info.st_size);
+
+    // a writer killed in the middle of a block leaves bytes after the last one, ./2048 stats must reject them
+    fd = open(path, O_WRONLY | O_APPEND);
+    success = success && fd >= 0 && write(fd, trailing, sizeof(trailing)) == (ssize_t) sizeof(trailing);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (success) {
+        // the error message is expected, keep it out of the test output
+        fflush(stderr);
+        err = dup(STDERR_FILENO);
+        devnull = open("/dev/null", O_WRONLY);
+        success = err >= 0 && devnull >= 0 && dup2(devnull, STDERR_FILENO) >= 0
+                  && summarizeAnalytics(1, arguments) == EXIT_FAILURE;
+        if (err >= 0) {
+            dup2(err, STDERR_FILENO);
+            close(err);
+        }
+        if (devnull >= 0) {
+            close(devnull);
+        }
+    }
+    unlink(path);
+    return success && k == stats.games;
+}
+
+/**
+ * @brief 기대값 탐색(expectimax) 에서 사용하는 상수입니다
+ * @remark 새 블럭은 addRandom 과 같이 빈 칸 중 하나에 90% 확률로 2, 10% 확률로 4 가 나타난다.
+ */
+#define SEARCH_SPAWN_2_PROBABILITY   0.9f
+#define SEARCH_SPAWN_4_PROBABILITY   0.1f
+#define SEARCH_PROBABILITY_THRESHOLD 0.0001f
+#define SEARCH_TABLE_BITS            20
+#define SEARCH_TABLE_DEPTH_LIMIT     15
+#define SEARCH_CANCEL_NODES          1024
+
+static float rowHeuristicTable[ROW_COUNT];
+
+/**
+ * @brief                       16비트 행(4칸) 전체에 대한 평가값 테이블을 만든다.
+ * @remark                      빈 칸과 합칠 수 있는 이웃이 많을수록, 값이 한 방향으로 단조롭게
+ *                              증가/감소할수록 높은 값을 준다.
+ */
+void initHeuristicTables(void)
+{
+    static bool initialized = false;
+    unsigned int row, i, value, previous, counter, empty, merges;
+    unsigned int line[SIZE];
+    double sum, left, right;
+
+    if (initialized) {
+        return;
+    }
+    for (row = 0; row < ROW_COUNT; row++) {
+        sum = 0;
+        empty = 0;
+        merges = 0;
+        previous = 0;
+        counter = 0;
+        for (i = 0; i < SIZE; i++) {
+            value = line[i] = (row >> (4 * i)) & 0xF;
+            sum += pow(value, 3.5);
+            if (value == 0) {
+                empty++;
+            } else {
+                if (previous == value) {
+                    counter++;
+                } else if (counter > 0) {
+                    merges += 1 + counter;
+                    counter = 0;
+                }
+                previous = value;
+            }
+        }
+        if (counter > 0) {
+            merges += 1 + counter;
+        }
+
+        left = 0;
+        right = 0;
+        for (i = 1; i < SIZE; i++) {
+            if (line[i - 1] > line[i]) {
+                left += pow(line[i - 1], 4) - pow(line[i], 4);
+            } else {
+                right += pow(line[i], 4) - pow(line[i - 1], 4);
+            }
+        }
+        rowHeuristicTable[row] = (float) (200000.0 + 270.0 * empty + 700.0 * merges
+                                          - 47.0 * (left < right ? left : right) - 11.0 * sum);
+    }
+    initialized = true;
+}
+
+float scoreHeuristic(board_t b)
+{
+    board_t t = transposeBoard(b);
+    float value = 0;
+    unsigned int i;
+    for (i = 0; i < SIZE; i++) {
+        value += rowHeuristicTable[(b >> (16 * i)) & ROW_MASK];
+        value += rowHeuristicTable[(t >> (16 * i)) & ROW_MASK];
+    }
+    return value;
+}
+
+/**
+ * @brief                       탐색 중에 이미 평가한 게임판을 저장하는 transposition table 의 항목
+ * @param board                 게임판
+ * @param value                 평가값
+ * @param depth                 평가할 때의 탐색 깊이, 더 얕은 곳에서 다시 만나면 재사용한다.
+ * @param generation            저장한 결정의 번호, 다른 결정에서 저장된 항목은 무시한다.
+ */
+typedef struct {
+    board_t board;
+    float value;
+    uint16_t depth;
+    uint16_t generation;
+} SearchEntry;
+
+/**
+ * @brief                       기대값 탐색의 상태
+ * @param table                 transposition table (2^SEARCH_TABLE_BITS 개)
+ * @param depth                 현재 탐색 중인 깊이
+ * @param depthLimit            이번 결정의 최대 깊이
+ * @param nodes                 지금까지 평가한 노드 수
+ * @param hits                  transposition table 에서 찾은 노드 수
+ * @param cancel                다른 스레드가 바꾸는 값, epoch 와 달라지면 탐색을 멈춘다. (NULL 이면 멈추지 않음)
+ * @param countdown             cancel 을 다시 읽을 때까지 남은 노드 수
+ * @param cancelled             탐색을 멈췄으면 true, 이때 결과는 의미가 없다.
+ */
+typedef struct {
+    SearchEntry *table;
+    uint16_t generation;
+    unsigned int depth;
+    unsigned int depthLimit;
+    unsigned long long nodes;
+    unsigned long long hits;
+    unsigned long long decisions;
+    const uint64_t *cancel;
+    uint64_t epoch;
+    unsigned int countdown;
+    bool cancelled;
+} Search;
+
+bool initSearch(Search *search)
+{
+    memset(search, 0, sizeof(*search));
+    search->table = calloc((size_t) 1 << SEARCH_TABLE_BITS, sizeof(search->table[0]));
+    initMoveTables();
+    initHeuristicTables();
+    return search->table != NULL;
+}
+
+void freeSearch(Search *search)
+{
+    free(search->table);
+    search->table = NULL;
+}
+
+static SearchEntry *searchEntry(Search *search, board_t b)
+{
+    return &search->table[(b * 0x9E3779B97F4A7C15ULL) >> (64 - SEARCH_TABLE_BITS)];
+}
+
+float scoreMoveNode(Search *search, board_t b, float probability);
+
+/**
+ * @brief                       새 블럭이 나타나는 노드의 기대값을 계산한다.
+ * @param Search search         탐색 상태
+ * @param board_t b             이동을 마친 게임판
+ * @param float probability     이 노드에 도달할 확률, 너무 작으면 더 탐색하지 않는다.
+ */
+float scoreSpawnNode(Search *search, board_t b, float probability)
+{
+    SearchEntry *entry = NULL;
+    unsigned int empty, i;
+    float value = 0;
+
+    if (probability < SEARCH_PROBABILITY_THRESHOLD || search->depth >= search->depthLimit) {
+        search->nodes++;
+        return scoreHeuristic(b);
+    }
+    if (search->depth < SEARCH_TABLE_DEPTH_LIMIT) {
+        entry = searchEntry(search, b);
+        if (entry->generation == search->generation && entry->board == b && entry->depth <= search->depth) {
+            search->hits++;
+            return entry->value;
+        }
+    }
+
+    empty = packedCountEmpty(b);
+    probability /= empty;
+    for (i = 0; i < SIZE * SIZE; i++) {
+        if (((b >> (4 * i)) & 0xF) == 0) {
+            value += scoreMoveNode(search, b | ((board_t) 1 << (4 * i)), probability * SEARCH_SPAWN_2_PROBABILITY)
+                     * SEARCH_SPAWN_2_PROBABILITY;
+            value += scoreMoveNode(search, b | ((board_t) 2 << (4 * i)), probability * SEARCH_SPAWN_4_PROBABILITY)
+                     * SEARCH_SPAWN_4_PROBABILITY;
+        }
+    }
+    value /= empty;
+
+    if (entry != NULL) {
+        entry->board = b;
+        entry->value = value;
+        entry->depth = search->depth;
+        entry->generation = search->generation;
+    }
+    return value;
+}
+
+/**
+ * @brief                       플레이어가 이동할 차례인 노드의 값 (가장 좋은 이동의 기대값) 을 계산한다.
+ */
+float scoreMoveNode(Search *search, board_t b, float probability)
+{
+    float best = 0;
+    float value;
+    unsigned int d, gained;
+    board_t moved;
+
+    if (search->cancel != NULL && --search->countdown == 0) {
+        // one shared load every SEARCH_CANCEL_NODES move nodes keeps the check off the hot path
+        search->countdown = SEARCH_CANCEL_NODES;
+        search->cancelled |= __atomic_load_n(search->cancel, __ATOMIC_RELAXED) != search->epoch;
+    }
+    if (search->cancelled) {
+        return 0;
+    }
+    search->nodes++;
+    search->depth++;
+    for (d = 0; d < MOVE_COUNT; d++) {
+        gained = 0;
+        moved = packedMove(b, d, &gained);
+        if (moved != b) {
+            value = scoreSpawnNode(search, moved, probability);
+            if (value > best) {
+                best = value;
+            }
+        }
+    }
+    search->depth--;
+    return best;
+}
+
+/**
+ * @brief                       정해진 깊이까지 기대값 탐색을 해서 가장 좋은 이동 방향을 찾는다.
+ * @param Search search         탐색 상태, search->cancelled 이면 결과를 버려야 한다.
+ * @param board_t b             현재 게임판
+ * @param unsigned int depthLimit 탐색할 이동 수 (1 이면 이동한 게임판을 바로 평가한다)
+ * @param float scores          방향별 기대값을 저장할 배열 (NULL 가능), 움직일 수 없는 방향은 0
+ * @return int                  가장 좋은 방향, 움직일 수 있는 방향이 없으면 -1
+ */
+int searchMoves(Search *search, board_t b, unsigned int depthLimit, float scores[MOVE_COUNT])
+{
+    unsigned int d, gained;
+    float value, best = 0;
+    board_t moved;
+    int bestMove = -1;
+
+    search->depthLimit = depthLimit;
+    search->depth = 0;
+    search->countdown = SEARCH_CANCEL_NODES;
+    search->cancelled = false;
+    // a new generation invalidates every entry of the previous decision
+    if (++search->generation == 0) {
+        memset(search->table, 0, ((size_t) 1 << SEARCH_TABLE_BITS) * sizeof(search->table[0]));
+        search->generation = 1;
+    }
+    search->decisions++;
+    for (d = 0; d < MOVE_COUNT; d++) {
+        gained = 0;
+        moved = packedMove(b, d, &gained);
+        value = 0;
+        if (moved != b) {
+            search->depth = 1;
+            value = scoreSpawnNode(search, moved, 1.0f) + 1e-6f;
+            if (value > best) {
+                best = value;
+                bestMove = d;
+            }
+        }
+        if (scores != NULL) {
+            scores[d] = value;
+        }
+    }
+    return bestMove;
+}
+
+/**
+ * @brief                       기대값 탐색으로 가장 좋은 이동 방향을 찾는다.
+ * @remark                      빈 칸이 적을수록 분기가 줄어드므로 더 깊이 탐색한다.
+ */
+int findBestMove(Search *search, board_t b, float scores[MOVE_COUNT])
+{
+    unsigned int empty = packedCountEmpty(b);
+
+    return searchMoves(search, b, empty > 7 ? 3 : empty > 3 ? 4 : 5, scores);
+}
+
+/**
+ * @brief 3x3 endgame tablebase 상수입니다
+ * @remark 3x3 게임판은 board_t 의 x, y < 3 인 칸에 담고 나머지 칸은 항상 0 이다.
+ *         tablebase 는 모든 칸의 지수가 target 보다 작은 3x3 게임판마다, 최선으로 두었을 때
+ *         2^target 블럭을 만들 확률을 담는다. (실제 이동 규칙과 2 가 90%, 4 가 10% 인 새 블럭)
+ *         이동은 타일 합을 바꾸지 않고 새 블럭은 2 나 4 를 더하므로, 타일 합이 큰 층부터 거꾸로 풀면
+ *         게임판 하나는 이미 푼 두 층 (합 + 2, 합 + 4) 만 본다. 그래서 메모리에는 세 층만 두고
+ *         푼 층은 바로 파일에 쓴다. 대칭인 게임판은 값이 같으므로 canonical 한 게임판만 저장한다.
+ *         파일: 헤더 TABLE_HEADER_SIZE 바이트 ("2048TBLB", 버전 (4), 크기 (4), target (4), 층 수 (4),
+ *         게임판 수 (8)), 층 목차 (층마다 위치 (8), 게임판 수 (8)), 층들.
+ *         층 번호는 타일 합 / 2 이고, 층은 정렬된 게임판 (board_t) 배열 뒤에 같은 순서의 확률 (float) 배열을
+ *         두고 8바이트 단위로 맞춘 것이다. 헤더와 목차의 정수는 little endian, 게임판과 확률은 실행하는
+ *         CPU 의 형식 그대로이므로 mmap 한 파일을 읽기만 하면 된다.
+ */
+#define TABLE_MAGIC                  "2048TBLB"
+#define TABLE_VERSION                1
+#define TABLE_SIZE                   3
+#define TABLE_HEADER_SIZE            64
+#define TABLE_INDEX_ENTRY_SIZE       16
+#define TABLE_MIN_TARGET             2
+#define TABLE_MAX_TARGET             15
+#define TABLE_DEFAULT_TARGET         8
+#define TABLE_DEFAULT_FILE           "2048.table"
+#define TABLE_THREAD_MIN_BOARDS      4096
+#define SMALL_EMPTY                  0x0000088808880888ULL
+
+/**
+ * @brief                       mmap 한 tablebase 파일
+ * @param target                목표 블럭의 지수
+ * @param layers                층 수, 층 번호는 타일 합 / 2
+ * @param positions             저장한 게임판 수
+ */
+struct Tablebase {
+    uint8_t *map;
+    size_t length;
+    unsigned int target;
+    unsigned int layers;
+    uint64_t positions;
+};
+
+/**
+ * @brief                       tablebase 의 층 하나, boards 는 정렬되어 있고 values[i] 가 boards[i] 의 확률이다.
+ */
+typedef struct {
+    const board_t *boards;
+    const float *values;
+    size_t count;
+} TableLayer;
+
+/**
+ * @brief                       tablebase 를 푸는 스레드 하나가 맡은 게임판들
+ */
+typedef struct {
+    const TableLayer *next;
+    const board_t *boards;
+    float *values;
+    size_t first;
+    size_t last;
+    unsigned int target;
+    pthread_t thread;
+    bool started;
+} TableWorker;
+
+/**
+ * @brief                       3x3 게임판을 위아래로 뒤집는다. (y <-> 2 - y)
+ */
+static ALWAYS_INLINE board_t flipSmall(board_t b)
+{
+    return (b & 0x000000F000F000F0ULL) | ((b & 0x0000000F000F000FULL) << 8) | ((b >> 8) & 0x0000000F000F000FULL);
+}
+
+/**
+ * @brief                       3x3 게임판을 좌우로 뒤집는다. (x <-> 2 - x)
+ */
+static ALWAYS_INLINE board_t mirrorSmall(board_t b)
+{
+    return (b & 0x00000000FFFF0000ULL) | ((b & ROW_MASK) << 32) | ((b >> 32) & ROW_MASK);
+}
+
+/**
+ * @brief                       board_t 에 담은 3x3 게임판을 이동한다.
+ * @remark                      위와 왼쪽은 비어 있는 네 번째 행과 열로 블럭이 가지 않으므로 4x4 이동과 같고,
+ *                              아래와 오른쪽은 3x3 게임판을 뒤집어서 위와 왼쪽으로 이동한다.
+ * @param board_t b             3x3 게임판
+ * @param unsigned int direction MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT 중 하나
+ * @param unsigned int gained   merge 로 얻은 점수를 더할 변수
+ * @return board_t              이동한 결과, 이동할 수 없으면 b 와 같은 값
+ */
+board_t smallMove(board_t b, unsigned int direction, unsigned int *gained)
+{
+    switch (direction) {
+        case MOVE_UP:
+            return packedMoveUp(b, gained);
+        case MOVE_DOWN:
+            return flipSmall(packedMoveUp(flipSmall(b), gained));
+        case MOVE_LEFT:
+            return packedMoveLeft(b, gained);
+        case MOVE_RIGHT:
+            return mirrorSmall(packedMoveLeft(mirrorSmall(b), gained));
+    }
+    return b;
+}
+
+/**
+ * @brief                       3x3 게임판의 빈 칸 하나에 2 또는 4 를 추가한다.
+ * @remark                      빈 칸을 addRandom 과 같은 순서로 센다.
+ * @return board_t              블럭이 추가된 게임판, 빈 칸이 없으면 b
+ */
+board_t smallAddRandom(board_t b, uint64_t *rng)
+{
+    board_t empty = zeroNibbles(b) & SMALL_EMPTY;
+    unsigned int len = __builtin_popcountll(empty);
+    unsigned int r;
+    board_t n;
+
+    if (len == 0) {
+        return b;
+    }
+    r = randomBelow(rng, len);
+    n = randomBelow(rng, 10) / 9 + 1;
+    return b | n << (selectBit(empty, r) - 3);
+}
+
+/**
+ * @brief                       3x3 게임판의 8가지 대칭 중 가장 작은 값
+ */
+board_t smallCanonical(board_t b)
+{
+    board_t images[4] = {b, flipSmall(b), mirrorSmall(b), 0};
+    board_t best = b;
+    unsigned int i;
+
+    images[3] = mirrorSmall(images[1]);
+    for (i = 0; i < 4; i++) {
+        best = images[i] < best ? images[i] : best;
+        // the 4x4 transpose keeps the 3x3 corner in place
+        images[i] = transposeBoard(images[i]);
+        best = images[i] < best ? images[i] : best;
+    }
+    return best;
+}
+
+/**
+ * @brief                       타일 합 / 2, 즉 게임판이 속한 층 번호
+ */
+static unsigned int smallLayer(board_t b)
+{
+    unsigned int sum = 0;
+    unsigned int value;
+
+    for (; b != 0; b >>= 4) {
+        value = b & 0xF;
+        sum += value != 0 ? 1u << (value - 1) : 0;
+    }
+    return sum;
+}
+
+/**
+ * @brief                       층에서 canonical 게임판의 확률을 이진 탐색으로 찾는다.
+ * @return float                확률, 층에 없으면 0
+ */
+static float layerValue(const TableLayer *layer, board_t b)
+{
+    size_t low = 0, high = layer->count, middle;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (layer->boards[middle] < b) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < layer->count && layer->boards[low] == b ? layer->values[low] : 0.0f;
+}
+
+/**
+ * @brief                       이동한 게임판에 새 블럭이 생긴 뒤의 확률
+ * @param TableLayer next       이동한 게임판보다 타일 합이 2, 4 큰 층
+ * @return float                이동으로 목표 블럭을 만들었으면 1
+ */
+static float spawnValue(board_t after, unsigned int target, const TableLayer next[2])
+{
+    board_t empty = zeroNibbles(after) & SMALL_EMPTY;
+    unsigned int count = __builtin_popcountll(empty);
+    unsigned int shift;
+    float value = 0;
+
+    if (packedMaxTile(after) >= target) {
+        return 1.0f;
+    }
+    if (count == 0) {
+        return 0.0f;
+    }
+    for (; empty != 0; empty &= empty - 1) {
+        shift = __builtin_ctzll(empty) - 3;
+        value += SEARCH_SPAWN_2_PROBABILITY * layerValue(&next[0], smallCanonical(after | 1ULL << shift))
+                 + SEARCH_SPAWN_4_PROBABILITY * layerValue(&next[1], smallCanonical(after | 2ULL << shift));
+    }
+    return value / count;
+}
+
+/**
+ * @brief                       게임판에서 이동마다 목표 블럭을 만들 확률을 계산한다.
+ * @param float scores          이동마다의 확률, 움직이지 않는 방향은 -1 (NULL 이면 저장하지 않음)
+ * @return int                  가장 좋은 이동 방향, 움직일 수 없으면 -1
+ */
+static int solveMoves(board_t b, unsigned int target, const TableLayer next[2], float scores[MOVE_COUNT])
+{
+    unsigned int d, gained;
+    board_t after;
+    float value, best = -1;
+    int move = -1;
+
+    for (d = 0; d < MOVE_COUNT; d++) {
+        gained = 0;
+        after = smallMove(b, d, &gained);
+        value = after == b ? -1.0f : spawnValue(after, target, next);
+        if (scores != NULL) {
+            scores[d] = value;
+        }
+        if (value > best) {
+            best = value;
+            move = d;
+        }
+    }
+    return move;
+}
+
+static void *solveWorker(void *arg)
+{
+    TableWorker *worker = arg;
+    float scores[MOVE_COUNT];
+    size_t i;
+    int d;
+
+    for (i = worker->first; i < worker->last; i++) {
+        d = solveMoves(worker->boards[i], worker->target, worker->next, scores);
+        worker->values[i] = d < 0 ? 0.0f : scores[d];
+    }
+    return NULL;
+}
+
+/**
+ * @brief                       타일 합이 2 * layer 이고 지수가 모두 target 보다 작은 canonical 게임판을
+ *                              작은 것부터 모은다.
+ * @remark                      높은 nibble 의 칸부터 작은 지수를 먼저 놓으므로 결과가 정렬되어 나온다.
+ *                              canonical 게임판은 가장 높은 nibble 의 모서리 칸이 네 모서리 중 가장 작으므로
+ *                              다른 모서리에는 그보다 작은 지수를 놓지 않는다.
+ * @param unsigned int cell     다음에 채울 칸 (smallCells 의 번호)
+ * @param unsigned long remaining 남은 칸들에 놓을 타일 합 / 2
+ */
+static bool enumerateLayer(Buffer *boards, board_t b, unsigned int cell, unsigned long remaining, unsigned int target)
+{
+    static const uint8_t smallCells[TABLE_SIZE * TABLE_SIZE] = {40, 36, 32, 24, 20, 16, 8, 4, 0};
+    const unsigned long largest = 1ul << (target - 2);
+    unsigned long half;
+    unsigned int value;
+
+    if (cell == TABLE_SIZE * TABLE_SIZE) {
+        return remaining != 0 || smallCanonical(b) != b || appendBuffer(boards, &b, sizeof(b));
+    }
+    if (remaining > (TABLE_SIZE * TABLE_SIZE - cell) * largest) {
+        return true;
+    }
+    // cells 2, 6 and 8 are the other corners
+    value = cell == 2 || cell == 6 || cell == 8 ? (b >> smallCells[0]) & 0xF : 0;
+    for (; value < target; value++) {
+        half = value != 0 ? 1ul << (value - 1) : 0;
+        if (half > remaining) {
+            break;
+        }
+        if (!enumerateLayer(boards, b | (board_t) value << smallCells[cell], cell + 1, remaining - half, target)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief                       층 하나의 게임판을 threads 개의 스레드로 나눠서 푼다.
+ */
+static void solveLayer(const TableLayer next[2], const board_t *boards, float *values, size_t count,
+                       unsigned int target, TableWorker *workers, unsigned int threads)
+{
+    unsigned int t;
+
+    if (count < TABLE_THREAD_MIN_BOARDS) {
+        threads = 1;
+    }
+    for (t = 0; t < threads; t++) {
+        workers[t].next = next;
+        workers[t].boards = boards;
+        workers[t].values = values;
+        workers[t].first = count * t / threads;
+        workers[t].last = count * (t + 1) / threads;
+        workers[t].target = target;
+        workers[t].started = t > 0 && pthread_create(&workers[t].thread, NULL, solveWorker, &workers[t]) == 0;
+    }
+    for (t = 0; t < threads; t++) {
+        if (!workers[t].started) {
+            solveWorker(&workers[t]);
+        }
+    }
+    for (t = 0; t < threads; t++) {
+        if (workers[t].started) {
+            pthread_join(workers[t].thread, NULL);
+        }
+    }
+}
+
+static bool writeFully(int fd, const void *data, size_t length, off_t offset)
+{
+    const uint8_t *p = data;
+    ssize_t written;
+
+    while (length > 0) {
+        written = pwrite(fd, p, length, offset);
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/**
+ * @brief                       3x3 tablebase 를 풀어서 파일에 쓴다.
+ * @remark                      타일 합이 가장 큰 층부터 층마다 게임판을 모으고, 스레드들이 나눠서 푼 뒤
+ *                              바로 파일 끝에 쓴다. 다음 층을 풀 때는 방금 푼 두 층만 필요하므로
+ *                              메모리는 가장 큰 세 층만큼만 쓴다. 목차와 헤더는 마지막에 쓴다.
+ * @param char path             만들 파일
+ * @param unsigned int target   목표 블럭의 지수
+ * @param unsigned int threads  스레드 수
+ * @param uint64_t positions    저장한 게임판 수
+ * @return bool                 파일을 쓸 수 없거나 메모리가 부족하면 false
+ */
+bool buildTablebase(const char *path, unsigned int target, unsigned int threads, uint64_t *positions)
+{
+    const unsigned int layers = TABLE_SIZE * TABLE_SIZE * (1u << (target - 2)) + 1;
+    const uint64_t padding = 0;
+    Buffer boards[3] = {{NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0}};
+    float *values[3] = {NULL, NULL, NULL};
+    TableLayer next[2] = {{NULL, NULL, 0}, {NULL, NULL, 0}};
+    uint8_t header[TABLE_HEADER_SIZE];
+    uint8_t *index;
+    TableWorker *workers;
+    Buffer swap;
+    float *swapValues;
+    off_t offset;
+    size_t count;
+    unsigned int layer;
+    bool success = true;
+    int fd;
+
+    *positions = 0;
+    threads = threads == 0 ? 1 : threads;
+    index = calloc(layers, TABLE_INDEX_ENTRY_SIZE);
+    workers = calloc(threads, sizeof(workers[0]));
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (index == NULL || workers == NULL || fd < 0) {
+        free(index);
+        free(workers);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    initMoveTables();
+    offset = TABLE_HEADER_SIZE + (off_t) layers * TABLE_INDEX_ENTRY_SIZE;
+    for (layer = layers; success && layer-- > 0;) {
+        // boards[0] is this layer, boards[1] and boards[2] the two already written above it
+        boards[0].length = 0;
+        success = enumerateLayer(&boards[0], 0, 0, layer, target);
+        count = boards[0].length / sizeof(board_t);
+        free(values[0]);
+        values[0] = malloc(count * sizeof(float) + sizeof(padding));
+        if (!success || values[0] == NULL) {
+            success = false;
+            break;
+        }
+        next[0] = (TableLayer) {(const board_t *) boards[1].data, values[1], boards[1].length / sizeof(board_t)};
+        next[1] = (TableLayer) {(const board_t *) boards[2].data, values[2], boards[2].length / sizeof(board_t)};
+        solveLayer(next, (const board_t *) boards[0].data, values[0], count, target, workers, threads);
+
+        putLittleEndian(index + (size_t) layer * TABLE_INDEX_ENTRY_SIZE, offset, 8);
+        putLittleEndian(index + (size_t) layer * TABLE_INDEX_ENTRY_SIZE + 8, count, 8);
+        success = writeFully(fd, boards[0].data, count * sizeof(board_t), offset)
+                  && writeFully(fd, values[0], count * sizeof(float), offset + count * sizeof(board_t))
+                  && writeFully(fd, &padding, count % 2 * sizeof(float), offset + count * (sizeof(board_t) + sizeof(float)));
+        offset += count * sizeof(board_t) + (count + count % 2) * sizeof(float);
+        *positions += count;
+
+        swap = boards[2];
+        boards[2] = boards[1];
+        boards[1] = boards[0];
+        boards[0] = swap;
+        swapValues = values[2];
+        values[2] = values[1];
+        values[1] = values[0];
+        values[0] = swapValues;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, TABLE_MAGIC, 8);
+    putLittleEndian(header + 8, TABLE_VERSION, 4);
+    putLittleEndian(header + 12, TABLE_SIZE, 4);
+    putLittleEndian(header + 16, target, 4);
+    putLittleEndian(header + 20, layers, 4);
+    putLittleEndian(header + 24, *positions, 8);
+    success = success && writeFully(fd, index, (size_t) layers * TABLE_INDEX_ENTRY_SIZE, TABLE_HEADER_SIZE)
+              && writeFully(fd, header, sizeof(header), 0);
+    success = close(fd) == 0 && success;
+    for (layer = 0; layer < 3; layer++) {
+        freeBuffer(&boards[layer]);
+        free(values[layer]);
+    }
+    free(index);
+    free(workers);
+    return success;
+}
+
+/**
+ * @brief                       tablebase 파일을 mmap 한다.
+ * @remark                      헤더와 목차의 크기만 확인하고 내용은 읽지 않으므로 파일 크기와 상관없이
+ *                              바로 열리고, 페이지는 처음 찾을 때 올라온다.
+ * @return bool                 파일을 열 수 없거나 형식이 맞지 않으면 false
+ */
+bool openTablebase(Tablebase *table, const char *path)
+{
+    struct stat info;
+    int fd;
+
+    memset(table, 0, sizeof(*table));
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < TABLE_HEADER_SIZE) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    table->length = info.st_size;
+    table->map = mmap(NULL, table->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (table->map == MAP_FAILED) {
+        table->map = NULL;
+        return false;
+    }
+    table->target = getLittleEndian(table->map + 16, 4);
+    table->layers = getLittleEndian(table->map + 20, 4);
+    table->positions = getLittleEndian(table->map + 24, 8);
+    if (memcmp(table->map, TABLE_MAGIC, 8) != 0 || getLittleEndian(table->map + 8, 4) != TABLE_VERSION
+        || getLittleEndian(table->map + 12, 4) != TABLE_SIZE
+        || table->target < TABLE_MIN_TARGET || table->target > TABLE_MAX_TARGET
+        || table->layers != TABLE_SIZE * TABLE_SIZE * (1u << (table->target - 2)) + 1
+        || table->length < TABLE_HEADER_SIZE + (size_t) table->layers * TABLE_INDEX_ENTRY_SIZE) {
+        munmap(table->map, table->length);
+        table->map = NULL;
+        return false;
+    }
+    posix_madvise(table->map, table->length, POSIX_MADV_RANDOM);
+    initMoveTables();
+    return true;
+}
+
+void closeTablebase(Tablebase *table)
+{
+    if (table->map != NULL) {
+        munmap(table->map, table->length);
+    }
+    table->map = NULL;
+}
+
+/**
+ * @brief                       목차에서 층 하나를 찾는다. 범위를 벗어난 층은 비어 있다.
+ */
+static TableLayer tableLayer(const Tablebase *table, unsigned int layer)
+{
+    const uint8_t *entry = table->map + TABLE_HEADER_SIZE + (size_t) layer * TABLE_INDEX_ENTRY_SIZE;
+    TableLayer result = {NULL, NULL, 0};
+    uint64_t offset, count;
+
+    if (layer >= table->layers) {
+        return result;
+    }
+    offset = getLittleEndian(entry, 8);
+    count = getLittleEndian(entry + 8, 8);
+    if (offset > table->length || count > (table->length - offset) / (sizeof(board_t) + sizeof(float))) {
+        return result;
+    }
+    result.boards = (const board_t *) (table->map + offset);
+    result.values = (const float *) (result.boards + count);
+    result.count = count;
+    return result;
+}
+
+/**
+ * @brief                       3x3 게임판에서 목표 블럭을 만들 확률을 찾는다.
+ * @return float                이미 목표 블럭이 있으면 1
+ */
+float tableValue(const Tablebase *table, board_t b)
+{
+    TableLayer layer;
+
+    if (packedMaxTile(b) >= table->target) {
+        return 1.0f;
+    }
+    layer = tableLayer(table, smallLayer(b));
+    return layerValue(&layer, smallCanonical(b));
+}
+
+/**
+ * @brief                       tablebase 로 3x3 게임판의 가장 좋은 이동을 고른다.
+ * @param float scores          이동마다 목표 블럭을 만들 확률, 움직이지 않는 방향은 -1 (NULL 가능)
+ * @return int                  이동 방향, 움직일 수 없거나 이미 목표 블럭이 있으면 -1
+ */
+int findTableMove(const Tablebase *table, board_t b, float scores[MOVE_COUNT])
+{
+    TableLayer next[2];
+    unsigned int layer = smallLayer(b);
+
+    if (packedMaxTile(b) >= table->target) {
+        return -1;
+    }
+    next[0] = tableLayer(table, layer + 1);
+    next[1] = tableLayer(table, layer + 2);
+    return solveMoves(b, table->target, next, scores);
+}
+
+/**
+ * @brief                       새 게임 (빈 게임판에 블럭 두 개) 에서 목표 블럭을 만들 확률
+ */
+double tableStartValue(const Tablebase *table)
+{
+    const double spawn[2] = {SEARCH_SPAWN_2_PROBABILITY, SEARCH_SPAWN_4_PROBABILITY};
+    const unsigned int cells = TABLE_SIZE * TABLE_SIZE;
+    double value = 0;
+    unsigned int i, j, a, c;
+    board_t b;
+
+    for (i = 0; i < cells; i++) {
+        for (j = 0; j < cells; j++) {
+            for (a = 0; i != j && a < 2; a++) {
+                for (c = 0; c < 2; c++) {
+                    b = (board_t) (a + 1) << (4 * (4 * (i / 3) + i % 3)) | (board_t) (c + 1) << (4 * (4 * (j / 3) + j % 3));
+                    value += spawn[a] * spawn[c] * tableValue(table, b);
+                }
+            }
+        }
+    }
+    return value / (cells * (cells - 1));
+}
+
+/**
+ * @brief                       3x3 endgame tablebase 를 만든다.
+ *                              --target TILE (목표 블럭, 기본 256), --threads N, --output FILE
+ * @param int argc              "tablebase" 이후 실행 파라미터의 개수
+ * @param int argv              "tablebase" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int tablebase(int argc, char *argv[])
+{
+    const char *path = TABLE_DEFAULT_FILE;
+    unsigned int threads = onlineProcessors();
+    unsigned int target = TABLE_DEFAULT_TARGET;
+    unsigned long tile;
+    uint64_t positions;
+    struct timespec start;
+    double seconds;
+    Tablebase table;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--target") == 0) {
+            tile = strtoul(argv[++i], NULL, 10);
+            // a power of two from 4 to 32768
+            for (target = 0; target <= TABLE_MAX_TARGET && (1ul << target) != tile; target++) {
+            }
+            if (target < TABLE_MIN_TARGET || target > TABLE_MAX_TARGET) {
+                argc = -1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--output") == 0) {
+            path = argv[++i];
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0) {
+        fprintf(stderr, "usage: 2048 tablebase [--target TILE] [--threads N] [--output FILE]\n");
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!buildTablebase(path, target, threads, &positions)) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    seconds = elapsedSeconds(&start);
+    if (!openTablebase(&table, path)) {
+        fprintf(stderr, "cannot read back %s\n", path);
+        return EXIT_FAILURE;
+    }
+    printf("positions      %llu\n", (unsigned long long) positions);
+    printf("file size      %zu bytes\n", table.length);
+    printf("positions/sec  %.1f\n", positions / seconds);
+    printf("reach %-8u %.4f%% from a new game\n", 1u << target, 100.0 * tableStartValue(&table));
+    closeTablebase(&table);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief                       작은 tablebase 를 만들어서 이동, 대칭과 확률이 맞는지 확인한다.
+ * @return bool                 3x3 이동이 Game 의 이동과 같고 저장한 확률이 다시 계산한 확률과 같으면 true
+ */
+bool testTablebase(void)
+{
+    char path[] = "/tmp/2048-tablebase-XXXXXX";
+    // 2 4 2 / 4 2 4 / 2 4 2 has no move, two 8s next to each other make 16
+    const board_t stuck = 0x0000012102120121ULL;
+    const board_t merge = 0x0000000000000033ULL;
+    uint64_t rng = seedRandom(5, 0);
+    uint64_t positions;
+    Tablebase table;
+    float scores[MOVE_COUNT];
+    Game game;
+    board_t b, after;
+    unsigned int i, d, gained;
+    bool success = true;
+    int fd, move;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    // 2^4 = 16
+    if (!buildTablebase(path, 4, 2, &positions) || !openTablebase(&table, path)) {
+        unlink(path);
+        return false;
+    }
+    unlink(path);
+
+    memset(&game, 0, sizeof(game));
+    setBoardSize(&game, TABLE_SIZE);
+    for (i = 0; success && i < 1000; i++) {
+        b = smallAddRandom(smallAddRandom(0, &rng), &rng);
+        while ((move = findTableMove(&table, b, scores)) >= 0) {
+            // the stored probability is the best move's
+            success &= fabsf(tableValue(&table, b) - scores[move]) < 1e-6f;
+            success &= tableValue(&table, transposeBoard(b)) == tableValue(&table, b)
+                       && tableValue(&table, flipSmall(mirrorSmall(b))) == tableValue(&table, b);
+            d = randomBelow(&rng, MOVE_COUNT);
+            unpackBoard(b, game.board);
+            refreshMasks(&game);
+            gained = 0;
+            after = smallMove(b, d, &gained);
+            game.score = 0;
+            success &= referenceMove(&game, d) == (after != b) && packBoard(game.board) == after
+                       && game.score == gained;
+            b = after != b ? smallAddRandom(after, &rng) : smallAddRandom(smallMove(b, move, &gained), &rng);
+        }
+    }
+    success &= positions == table.positions && positions > 0
+               && tableValue(&table, stuck) == 0.0f && tableValue(&table, merge) == 1.0f
+               && findTableMove(&table, stuck, NULL) == -1 && tableValue(&table, 0x4ULL) == 1.0f;
+    closeTablebase(&table);
+    return success;
+}
+
+/**
+ * @brief                       현재 게임판에서 가장 좋은 이동 방향을 메시지 줄에 출력한다.
+ * @remark                      3x3 게임에 tablebase 가 있으면 탐색 대신 tablebase 의 이동과 확률을 보여준다.
+ * @param Game game             진행 중인 게임
+ * @param Search search         탐색 상태, 처음 사용할 때 초기화한다.
+ */
+void printHint(Game *game, Search *search)
+{
+    const char *names[] = {"↑ (up)   ", "↓ (down) ", "← (left) ", "→ (right)"};
+    float scores[MOVE_COUNT];
+    board_t b;
+    int d;
+
+    if (game->size == TABLE_SIZE && game->tablebase != NULL) {
+        // the 3x3 board sits in the corner of a board_t
+        b = packBoard(game->board);
+        d = findTableMove(game->tablebase, b, scores);
+        if (packedMaxTile(b) >= game->tablebase->target) {
+            printf("   TABLEBASE TARGET REACHED \n");
+        } else if (d < 0) {
+            printf("      NO MOVES LEFT         \n");
+        } else {
+            printf("   HINT: %s %5.1f%%   \n", names[d], 100.0 * scores[d]);
+        }
+        return;
+    }
+    if (game->size != SIZE) {
+        // the search works on board_t, which only holds a 4x4 board
+        printf("   HINT ONLY ON 4x4 BOARD   \n");
+        return;
+    }
+    if (search->table == NULL && !initSearch(search)) {
+        printf("      HINT UNAVAILABLE      \n");
+        return;
+    }
+    d = findBestMove(search, packBoard(game->board), NULL);
+    if (d < 0) {
+        printf("      NO MOVES LEFT         \n");
+        return;
+    }
+    printf("       HINT: %s      \n", names[d]);
+}
+
+/**
+ * @brief 배경 분석 스레드 상수입니다
+ * @remark 분석 스레드는 요청받은 4x4 게임판을 깊이 1 부터 ANALYSIS_MAX_DEPTH 까지 한 단계씩 깊게 탐색하고,
+ *         깊이 하나를 마칠 때마다 결과를 우편함에 넣는다. 새 게임판을 요청하면 진행 중인 탐색은
+ *         이동 노드 SEARCH_CANCEL_NODES 개 안에 멈추고 새 게임판을 깊이 1 부터 다시 탐색한다.
+ *         우편함은 슬롯 세 개를 돌려 쓰는 triple buffer 이다. 쓰는 쪽은 자기 슬롯을 채운 뒤 latest 와
+ *         바꾸고, 읽는 쪽은 새 결과가 있을 때만 자기 슬롯과 latest 를 바꾸므로 어느 쪽도 기다리지 않는다.
+ */
+#define ANALYSIS_MAX_DEPTH           8
+#define ANALYSIS_FRESH               4
+#define ANALYSIS_SLOT_MASK           3
+
+/**
+ * @brief                       분석 결과 하나
+ * @param board                 분석한 게임판, 화면의 게임판과 다르면 보여주지 않는다.
+ * @param scores                방향별 기대값, 움직일 수 없는 방향은 0
+ * @param move                  가장 좋은 방향, 움직일 수 없으면 -1
+ * @param depth                 탐색을 마친 깊이, 0 이면 아직 결과가 없다.
+ */
+typedef struct {
+    board_t board;
+    float scores[MOVE_COUNT];
+    int move;
+    unsigned int depth;
+} AnalysisResult;
+
+/**
+ * @brief                       배경 분석 스레드와 주고받는 상태
+ * @param slots                 우편함의 슬롯, back 은 분석 스레드가, front 는 화면이 가진 슬롯이다.
+ * @param latest                가장 최근 결과의 슬롯 번호, 화면이 아직 가져가지 않았으면 ANALYSIS_FRESH 가 켜진다.
+ * @param board                 분석할 게임판, epoch 를 올리기 전에 쓴다.
+ * @param epoch                 요청 번호, 바뀌면 진행 중인 탐색이 멈춘다.
+ * @param stop                  true 이면 분석 스레드가 끝난다.
+ * @param wake                  요청이 있을 때 분석 스레드를 깨우는 세마포어
+ * @param pipe                  결과를 넣을 때마다 한 바이트를 쓰는 pipe, 입력을 기다리는 poll 이 함께 본다.
+ */
+struct Analysis {
+    AnalysisResult slots[3];
+    unsigned int latest;
+    unsigned int back;
+    unsigned int front;
+    board_t board;
+    uint64_t epoch;
+    bool stop;
+    sem_t wake;
+    int pipe[2];
+    pthread_t thread;
+    Search search;
+};
+
+static void *analysisWorker(void *arg)
+{
+    Analysis *analysis = arg;
+    AnalysisResult *result;
+    uint64_t epoch, done = 0;
+    unsigned int depth;
+    const char wake = 0;
+    board_t b;
+    int move;
+
+    while (!__atomic_load_n(&analysis->stop, __ATOMIC_ACQUIRE)) {
+        if (sem_wait(&analysis->wake) != 0) {
+            continue;
+        }
+        epoch = __atomic_load_n(&analysis->epoch, __ATOMIC_ACQUIRE);
+        if (epoch == done) {
+            continue;
+        }
+        done = epoch;
+        // the board may already be newer than epoch, the result names the board it is for
+        b = __atomic_load_n(&analysis->board, __ATOMIC_RELAXED);
+        analysis->search.epoch = epoch;
+        for (depth = 1; depth <= ANALYSIS_MAX_DEPTH; depth++) {
+            result = &analysis->slots[analysis->back];
+            move = searchMoves(&analysis->search, b, depth, result->scores);
+            if (analysis->search.cancelled || __atomic_load_n(&analysis->epoch, __ATOMIC_RELAXED) != epoch) {
+                break;
+            }
+            result->board = b;
+            result->move = move;
+            result->depth = depth;
+            analysis->back = __atomic_exchange_n(&analysis->latest, analysis->back | ANALYSIS_FRESH, __ATOMIC_ACQ_REL)
+                             & ANALYSIS_SLOT_MASK;
+            if (write(analysis->pipe[1], &wake, 1) < 0) {
+                // the pipe is full, the reader has a wake-up pending anyway
+            }
+            if (move < 0) {
+                break;
+            }
+        }
+    }
+    mergeStats();
+    return NULL;
+}
+
+/**
+ * @brief                       배경 분석 스레드를 시작한다.
+ * @return bool                 스레드, pipe 나 transposition table 을 만들 수 없으면 false
+ */
+bool initAnalysis(Analysis *analysis)
+{
+    sigset_t all, old;
+    bool started;
+
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->latest = 1;
+    analysis->back = 2;
+    if (!initSearch(&analysis->search)) {
+        return false;
+    }
+    analysis->search.cancel = &analysis->epoch;
+    if (pipe(analysis->pipe) != 0) {
+        freeSearch(&analysis->search);
+        return false;
+    }
+    // neither side may ever block on the pipe
+    fcntl(analysis->pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(analysis->pipe[1], F_SETFL, O_NONBLOCK);
+    // the thread starts with every signal blocked, so Ctrl-C and SIGUSR1 interrupt the main loop's poll
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    started = sem_init(&analysis->wake, 0, 0) == 0
+              && pthread_create(&analysis->thread, NULL, analysisWorker, analysis) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (!started) {
+        close(analysis->pipe[0]);
+        close(analysis->pipe[1]);
+        freeSearch(&analysis->search);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief                       진행 중인 탐색을 멈추고 분석 스레드를 끝낸다.
+ */
+void freeAnalysis(Analysis *analysis)
+{
+    __atomic_store_n(&analysis->stop, true, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&analysis->epoch, 1, __ATOMIC_RELEASE);
+    sem_post(&analysis->wake);
+    pthread_join(analysis->thread, NULL);
+    sem_destroy(&analysis->wake);
+    close(analysis->pipe[0]);
+    close(analysis->pipe[1]);
+    freeSearch(&analysis->search);
+}
+
+/**
+ * @brief                       게임판의 분석을 요청한다. 같은 게임판을 이미 요청했으면 아무것도 하지 않는다.
+ * @remark                      기다리지 않으므로 입력을 처리하는 중에 불러도 된다.
+ */
+void requestAnalysis(Analysis *analysis, board_t b)
+{
+    // only this thread writes epoch and board
+    if (analysis->epoch != 0 && analysis->board == b) {
+        return;
+    }
+    __atomic_store_n(&analysis->board, b, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&analysis->epoch, 1, __ATOMIC_RELEASE);
+    sem_post(&analysis->wake);
+}
+
+/**
+ * @brief                       우편함에서 가장 최근 결과를 가져온다.
+ * @return AnalysisResult       화면 쪽 슬롯, 다음 readAnalysis 까지 분석 스레드가 건드리지 않는다.
+ */
+const AnalysisResult *readAnalysis(Analysis *analysis)
+{
+    char drained[64];
+
+    while (read(analysis->pipe[0], drained, sizeof(drained)) > 0) {
+    }
+    if (__atomic_load_n(&analysis->latest, __ATOMIC_ACQUIRE) & ANALYSIS_FRESH) {
+        analysis->front = __atomic_exchange_n(&analysis->latest, analysis->front, __ATOMIC_ACQ_REL) & ANALYSIS_SLOT_MASK;
+    }
+    return &analysis->slots[analysis->front];
+}
+
+/**
+ * @brief                       점수 줄 오른쪽에 현재 게임판의 분석 결과를 그린다.
+ * @remark                      가장 좋은 방향과 탐색을 마친 깊이, 방향마다 가장 좋은 방향보다 모자란 기대값을
+ *                              보여준다. 분석은 4x4 게임판에서만 한다.
+ * @param Game game             화면에 출력할 게임
+ */
+void drawAnalysis(Game *game)
+{
+    const char *arrows[] = {"↑", "↓", "←", "→"};
+    Screen *screen = game->screen;
+    const AnalysisResult *result;
+    char text[sizeof(screen->shownAnalysis)];
+    size_t length = 0;
+    unsigned int d;
+
+    if (game->size != SIZE) {
+        return;
+    }
+    result = readAnalysis(game->analysis);
+    text[0] = '\0';
+    if (result->board != packBoard(game->board) || result->depth == 0) {
+        length = snprintf(text, sizeof(text), "  thinking");
+    } else if (result->move >= 0) {
+        length = snprintf(text, sizeof(text), "  %s d%u ", arrows[result->move], result->depth);
+        for (d = 0; d < MOVE_COUNT && length < sizeof(text); d++) {
+            if ((int) d == result->move) {
+                length += snprintf(text + length, sizeof(text) - length, " %s best", arrows[d]);
+            } else if (result->scores[d] <= 0) {
+                length += snprintf(text + length, sizeof(text) - length, " %s --", arrows[d]);
+            } else {
+                length += snprintf(text + length, sizeof(text) - length, " %s -%.0f", arrows[d],
+                                   (double) (result->scores[result->move] - result->scores[d]));
+            }
+        }
+    }
+    if (screen->valid && strcmp(text, screen->shownAnalysis) == 0) {
+        return;
+    }
+    // the score takes the first 28 columns, clear whatever the last analysis left
+    appendCursor(screen, 1, 29);
+    appendFormat(screen, "%s\033[K", text);
+    memcpy(screen->shownAnalysis, text, sizeof(text));
+}
+
+/**
+ * @brief                       분석 스레드가 새 요청으로 넘어가고 같은 깊이의 탐색과 같은 결과를 내는지 확인한다.
+ * @return bool                 두 번째 게임판의 결과가 10초 안에 나오고 직접 탐색한 결과와 같으며,
+ *                              cancel 이 바뀐 탐색이 이동 노드 SEARCH_CANCEL_NODES 개 안에 멈추면 true
+ */
+bool testAnalysis(void)
+{
+    // an almost empty board takes long at the deeper levels, the second one is what is waited for
+    const board_t first = 0x0000000000100001ULL;
+    const board_t second = 0x0000000100220135ULL;
+    const AnalysisResult *result = NULL;
+    float scores[MOVE_COUNT];
+    Analysis analysis;
+    Search search;
+    struct pollfd fd;
+    uint64_t cancel = 1;
+    unsigned int i;
+    bool success;
+    int move;
+
+    if (!initAnalysis(&analysis)) {
+        return false;
+    }
+    if (!initSearch(&search)) {
+        freeAnalysis(&analysis);
+        return false;
+    }
+    requestAnalysis(&analysis, first);
+    requestAnalysis(&analysis, second);
+    for (i = 0; i < 1000; i++) {
+        fd = (struct pollfd) {analysis.pipe[0], POLLIN, 0};
+        poll(&fd, 1, 10);
+        result = readAnalysis(&analysis);
+        if (result->board == second && result->depth >= 2) {
+            break;
+        }
+    }
+    move = searchMoves(&search, second, result->depth, scores);
+    success = i < 1000 && result->move == move && memcmp(result->scores, scores, sizeof(scores)) == 0;
+    // stops a search that would otherwise run for minutes
+    freeAnalysis(&analysis);
+
+    search.cancel = &cancel;
+    search.nodes = 0;
+    searchMoves(&search, first, ANALYSIS_MAX_DEPTH, NULL);
+    // a move node counts itself and at most one leaf per direction
+    success &= search.cancelled && search.nodes <= (MOVE_COUNT + 1) * SEARCH_CANCEL_NODES;
+    freeSearch(&search);
+    return success;
+}
+
+/**
+ * @brief 무작위 playout 으로 이동을 고르는 (Monte Carlo) 플레이어의 상수입니다
+ * @remark 작업 하나는 한 방향의 playout ROLLOUT_CHUNK 개를 BoardBatch 하나로 함께 진행한다.
+ */
+#define ROLLOUT_CHUNK                BATCH_BLOCK
+#define ROLLOUT_DEFAULT_BUDGET       100
+#define ROLLOUT_DEFAULT_PLAYOUTS     1024
+
+/**
+ * @brief                       playout 작업 하나
+ * @param board                 move 방향으로 이동한 뒤, 새 블럭을 추가하기 전의 게임판
+ * @param move                  첫 이동 방향
+ * @param gained                첫 이동으로 얻은 점수
+ */
+typedef struct {
+    board_t board;
+    unsigned int move;
+    unsigned int gained;
+} RolloutTask;
+
+/**
+ * @brief                       스레드 하나가 가진 작업 덱
+ * @remark                      주인은 tail 쪽에서 꺼내고, 일이 떨어진 다른 스레드는 head 쪽에서 훔쳐 간다.
+ *                              양쪽 모두 짧은 구간만 lock 을 잡으므로 경쟁은 훔칠 때에만 생긴다.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    RolloutTask *tasks;
+    unsigned int head;
+    unsigned int tail;
+} TaskDeque;
+
+typedef struct RolloutPool RolloutPool;
+
+/**
+ * @brief                       playout 스레드 하나의 상태
+ * @param sums                  이번 결정에서 방향별로 끝까지 진행한 playout 의 점수 합 (counts 는 개수)
+ * @param playouts              지금까지 끝까지 진행한 playout 수
+ * @param padding               이웃한 스레드의 카운터가 같은 캐시 라인에 놓이지 않게 한다.
+ */
+typedef struct {
+    RolloutPool *pool;
+    unsigned int index;
+    pthread_t thread;
+    bool started;
+    TaskDeque deque;
+    uint64_t rng;
+    unsigned long long sums[MOVE_COUNT];
+    unsigned long counts[MOVE_COUNT];
+    unsigned long long playouts;
+    board_t boards[ROLLOUT_CHUNK];
+    unsigned int scores[ROLLOUT_CHUNK];
+    uint64_t rngs[ROLLOUT_CHUNK];
+    uint8_t directions[ROLLOUT_CHUNK];
+    char padding[64];
+} RolloutWorker;
+
+/**
+ * @brief                       work-stealing 스레드 풀
+ * @param generation            결정 번호, 바뀌면 잠든 스레드들이 깨어나 새 작업을 처리한다.
+ * @param busy                  이번 결정을 아직 처리 중인 스레드 수
+ * @param cancel                시간이 다 되면 1, 스레드들은 진행 중인 작업을 버리고 멈춘다.
+ * @param budget                결정 하나에 쓰는 최대 시간 (밀리초)
+ * @param playouts              결정 하나에서 방향마다 진행할 최대 playout 수
+ */
+struct RolloutPool {
+    unsigned int threads;
+    RolloutWorker *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long generation;
+    unsigned int busy;
+    int cancel;
+    bool quit;
+    unsigned int budget;
+    unsigned int playouts;
+    unsigned int capacity;
+};
+
+static bool popTask(TaskDeque *deque, RolloutTask *task)
+{
+    bool found;
+
+    pthread_mutex_lock(&deque->lock);
+    found = deque->head != deque->tail;
+    if (found) {
+        *task = deque->tasks[--deque->tail];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+/**
+ * @brief                       다른 스레드의 덱에서 가장 오래된 작업을 훔친다.
+ * @remark                      훔칠 덱은 worker 다음 번호부터 차례로 살펴보므로 한 덱에 몰리지 않는다.
+ */
+static bool stealTask(RolloutWorker *worker, RolloutTask *task)
+{
+    RolloutPool *pool = worker->pool;
+    TaskDeque *victim;
+    unsigned int i;
+    bool found = false;
+
+    for (i = 1; i < pool->threads && !found; i++) {
+        victim = &pool->workers[(worker->index + i) % pool->threads].deque;
+        pthread_mutex_lock(&victim->lock);
+        found = victim->head != victim->tail;
+        if (found) {
+            *task = victim->tasks[victim->head++];
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+/**
+ * @brief                       작업 하나의 playout 들을 무작위 이동으로 게임이 끝날 때까지 진행한다.
+ * @remark                      게임마다 매번 무작위 방향을 고르고, 움직일 수 없는 방향이 나온 게임은 그 차례를
+ *                              쉬므로 결과는 가능한 방향 중 하나를 고르게 고르는 것과 같다.
+ *                              중간에 취소되면 짧게 끝난 게임만 남아 평균이 낮아지므로 결과를 모두 버린다.
+ * @return bool                 모든 playout 이 끝났으면 true, 취소되었으면 false
+ */
+static bool runRollouts(RolloutWorker *worker, const RolloutTask *task)
+{
+    BoardBatch batch = {ROLLOUT_CHUNK, worker->boards, worker->scores, worker->rngs};
+    uint64_t changed[BATCH_WORDS(ROLLOUT_CHUNK)];
+    uint64_t ended[BATCH_WORDS(ROLLOUT_CHUNK)];
+    uint32_t bits = 0;
+    unsigned int i;
+
+    for (i = 0; i < ROLLOUT_CHUNK; i++) {
+        worker->boards[i] = task->board;
+        worker->scores[i] = task->gained;
+        worker->rngs[i] = seedRandom(nextRandom(&worker->rng), i);
+    }
+    batchAddRandom(&batch, NULL);
+    for (;;) {
+        batchGameEnded(&batch, ended);
+        if (ended[0] == ~(uint64_t) 0) {
+            break;
+        }
+        if (__atomic_load_n(&worker->pool->cancel, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        for (i = 0; i < ROLLOUT_CHUNK; i++) {
+            if (i % 16 == 0) {
+                bits = nextRandom(&worker->rng);
+            }
+            worker->directions[i] = bits & 3;
+            bits >>= 2;
+        }
+        batchMove(&batch, worker->directions, changed);
+        batchAddRandom(&batch, changed);
+    }
+    for (i = 0; i < ROLLOUT_CHUNK; i++) {
+        worker->sums[task->move] += worker->scores[i];
+    }
+    worker->counts[task->move] += ROLLOUT_CHUNK;
+    worker->playouts += ROLLOUT_CHUNK;
+    return true;
+}
+
+static void *rolloutWorker(void *arg)
+{
+    RolloutWorker *worker = arg;
+    RolloutPool *pool = worker->pool;
+    unsigned long seen = 0;
+    // popTask and stealTask fill it under a lock, which the compiler cannot see through
+    RolloutTask task = {0};
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        while (!__atomic_load_n(&pool->cancel, __ATOMIC_RELAXED)
+               && (popTask(&worker->deque, &task) || stealTask(worker, &task))) {
+            runRollouts(worker, &task);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief                       스레드들을 멈추고 풀의 메모리를 해제한다.
+ */
+void freeRolloutPool(RolloutPool *pool)
+{
+    unsigned int t;
+
+    if (pool->workers == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (t = 0; t < pool->threads; t++) {
+        if (pool->workers[t].started) {
+            pthread_join(pool->workers[t].thread, NULL);
+        }
+        free(pool->workers[t].deque.tasks);
+        pthread_mutex_destroy(&pool->workers[t].deque.lock);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    pool->workers = NULL;
+}
+
+/**
+ * @brief                       playout 스레드 풀을 만든다.
+ * @param unsigned int threads  스레드 수
+ * @param unsigned int budget   결정 하나에 쓰는 최대 시간 (밀리초)
+ * @param unsigned int playouts 결정 하나에서 방향마다 진행할 최대 playout 수
+ * @param uint64_t seed         난수 초기값, 스레드 t 는 seedRandom(seed, t) 를 사용한다.
+ * @return bool                 메모리나 스레드를 만들 수 없으면 false
+ */
+bool initRolloutPool(RolloutPool *pool, unsigned int threads, unsigned int budget, unsigned int playouts, uint64_t seed)
+{
+    pthread_condattr_t attributes;
+    unsigned int t;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = threads > 0 ? threads : 1;
+    pool->budget = budget;
+    pool->playouts = playouts;
+    // a worker may be dealt every chunk of every move
+    pool->capacity = MOVE_COUNT * ((playouts + ROLLOUT_CHUNK - 1) / ROLLOUT_CHUNK);
+    pool->workers = calloc(pool->threads, sizeof(pool->workers[0]));
+    if (pool->workers == NULL) {
+        return false;
+    }
+    initMoveTables();
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_condattr_init(&attributes);
+    // the deadline is measured on the same clock as elapsedSeconds
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->done, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_cond_init(&pool->wake, NULL);
+    for (t = 0; t < pool->threads; t++) {
+        pool->workers[t].pool = pool;
+        pool->workers[t].index = t;
+        pool->workers[t].rng = seedRandom(seed, t);
+        pthread_mutex_init(&pool->workers[t].deque.lock, NULL);
+        pool->workers[t].deque.tasks = malloc(pool->capacity * sizeof(RolloutTask));
+    }
+    for (t = 0; t < pool->threads; t++) {
+        pool->workers[t].started = pool->workers[t].deque.tasks != NULL
+                                   && pthread_create(&pool->workers[t].thread, NULL, rolloutWorker, &pool->workers[t]) == 0;
+        if (!pool->workers[t].started) {
+            freeRolloutPool(pool);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief                       방향마다 무작위 playout 을 진행해서 평균 최종 점수가 가장 높은 방향을 찾는다.
+ * @remark                      작업은 방향을 번갈아 가며 스레드들의 덱에 고르게 나누어 주므로, 시간이 다 되어
+ *                              취소되더라도 방향마다 비슷한 수의 playout 이 끝나 있다.
+ *                              먼저 끝난 스레드는 다른 스레드의 작업을 훔쳐서 처리한다.
+ * @param RolloutPool pool      스레드 풀
+ * @param board_t b             현재 게임판
+ * @param float scores          방향별 평균 점수를 저장할 배열 (NULL 가능), 움직일 수 없는 방향은 0
+ * @return int                  가장 좋은 방향, 움직일 수 있는 방향이 없으면 -1
+ */
+int findRolloutMove(RolloutPool *pool, board_t b, float scores[MOVE_COUNT])
+{
+    RolloutTask legal[MOVE_COUNT];
+    struct timespec deadline;
+    unsigned long long sum;
+    unsigned long count;
+    unsigned int moves = 0, chunks, c, d, i, t;
+    float value, best = -1;
+    int bestMove = -1;
+
+    for (d = 0; d < MOVE_COUNT; d++) {
+        legal[moves].gained = 0;
+        legal[moves].board = packedMove(b, d, &legal[moves].gained);
+        legal[moves].move = d;
+        if (scores != NULL) {
+            scores[d] = 0;
+        }
+        if (legal[moves].board != b) {
+            moves++;
+        }
+    }
+    if (moves <= 1) {
+        // nothing to compare
+        return moves == 0 ? -1 : (int) legal[0].move;
+    }
+
+    chunks = (pool->playouts + ROLLOUT_CHUNK - 1) / ROLLOUT_CHUNK;
+    for (t = 0; t < pool->threads; t++) {
+        memset(pool->workers[t].sums, 0, sizeof(pool->workers[t].sums));
+        memset(pool->workers[t].counts, 0, sizeof(pool->workers[t].counts));
+        pool->workers[t].deque.head = 0;
+        pool->workers[t].deque.tail = 0;
+    }
+    // deal moves in turn, so a cancelled decision still has every move about equally sampled
+    for (c = 0, t = 0; c < chunks; c++) {
+        for (i = 0; i < moves; i++, t = (t + 1) % pool->threads) {
+            pool->workers[t].deque.tasks[pool->workers[t].deque.tail++] = legal[(i + c) % moves];
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += pool->budget / 1000;
+    deadline.tv_nsec += (long) (pool->budget % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->cancel, 0, __ATOMIC_RELAXED);
+    pool->busy = pool->threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    while (pool->busy > 0) {
+        if (__atomic_load_n(&pool->cancel, __ATOMIC_RELAXED)) {
+            // the workers only have to finish their current batch step
+            pthread_cond_wait(&pool->done, &pool->lock);
+        } else if (pthread_cond_timedwait(&pool->done, &pool->lock, &deadline) == ETIMEDOUT) {
+            __atomic_store_n(&pool->cancel, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < moves; i++) {
+        d = legal[i].move;
+        sum = 0;
+        count = 0;
+        for (t = 0; t < pool->threads; t++) {
+            sum += pool->workers[t].sums[d];
+            count += pool->workers[t].counts[d];
+        }
+        value = count > 0 ? (float) sum / count : 0;
+        if (scores != NULL) {
+            scores[d] = value;
+        }
+        if (value > best) {
+            best = value;
+            bestMove = d;
+        }
+    }
+    return bestMove;
+}
+
+/**
+ * @brief                       지금까지 모든 스레드가 끝까지 진행한 playout 수
+ */
+unsigned long long rolloutPlayouts(const RolloutPool *pool)
+{
+    unsigned long long playouts = 0;
+    unsigned int t;
+
+    for (t = 0; t < pool->threads; t++) {
+        playouts += pool->workers[t].playouts;
+    }
+    return playouts;
+}
+
+/**
+ * @brief n-tuple 가치 함수의 상수입니다
+ * @remark 여섯 칸짜리 tuple 네 개를 게임판의 8가지 대칭 (회전, 뒤집기) 에 모두 적용한다.
+ *         tuple 하나의 테이블은 칸마다 지수 16가지이므로 16^6 개의 float 이다.
+ *         가중치 파일은 NTUPLE_HEADER_SIZE 바이트의 헤더 뒤에 테이블들을 순서대로 이어 붙인 것이다.
+ *         헤더: "2048NTUP", 버전 (4), tuple 수 (4), tuple 길이 (4), 학습한 게임 수 (8), tuple 칸들 (각 1),
+ *         헤더의 정수는 little endian, 테이블의 float 은 실행하는 CPU 의 형식 그대로이다.
+ */
+#define NTUPLE_COUNT                 4
+#define NTUPLE_LENGTH                6
+#define NTUPLE_SYMMETRIES            8
+#define NTUPLE_ENTRIES               ((size_t) 1 << (4 * NTUPLE_LENGTH))
+#define NTUPLE_MAGIC                 "2048NTUP"
+#define NTUPLE_VERSION               1
+#define NTUPLE_HEADER_SIZE           4096
+#define NTUPLE_DEFAULT_WEIGHTS       "2048.weights"
+#define NTUPLE_DEFAULT_ALPHA         0.1f
+
+/**
+ * @brief                       tuple 들의 칸, 값은 4 * x + y (board_t 의 nibble 번호)
+ */
+static const uint8_t ntupleCells[NTUPLE_COUNT][NTUPLE_LENGTH] = {
+    {0, 4, 8, 12, 1, 5},
+    {1, 5, 9, 13, 2, 6},
+    {0, 4, 8, 1, 5, 9},
+    {1, 5, 9, 2, 6, 10}
+};
+
+/**
+ * @brief                       n-tuple 가치 함수
+ * @param weights               NTUPLE_COUNT 개의 테이블, 가중치 파일을 mmap 한 영역을 가리킨다.
+ * @param map                   mmap 한 영역 (헤더 포함), length 는 그 길이
+ * @param shifts                tuple 과 대칭마다 각 칸의 nibble 위치 (비트 단위)
+ */
+typedef struct {
+    float *weights;
+    uint8_t *map;
+    size_t length;
+    uint8_t shifts[NTUPLE_COUNT * NTUPLE_SYMMETRIES][NTUPLE_LENGTH];
+} NTuple;
+
+/**
+ * @brief                       가중치 파일을 열어서 mmap 한다.
+ * @remark                      MAP_SHARED 로 매핑하므로 읽기만 하는 프로세스들은 같은 페이지를 공유하고,
+ *                              페이지는 처음 읽을 때 올라오므로 파일 크기와 상관없이 바로 시작한다.
+ *                              writable 이면 파일이 없을 때 0 으로 채운 파일을 만들고, 학습은 매핑된
+ *                              테이블을 직접 고치므로 따로 저장할 필요가 없다.
+ * @param NTuple net            가치 함수
+ * @param char path             가중치 파일, NULL 이면 파일 없이 0 으로 채운 메모리를 사용한다.
+ * @param bool writable         학습용으로 열지 여부
+ * @return bool                 파일을 열 수 없거나 형식이 맞지 않으면 false
+ */
+bool openTuples(NTuple *net, const char *path, bool writable)
+{
+    const size_t length = NTUPLE_HEADER_SIZE + NTUPLE_COUNT * NTUPLE_ENTRIES * sizeof(float);
+    uint8_t header[NTUPLE_HEADER_SIZE];
+    struct stat info;
+    unsigned int t, s, i, x, y, swap;
+    int fd = -1;
+
+    memset(net, 0, sizeof(*net));
+    memset(header, 0, sizeof(header));
+    memcpy(header, NTUPLE_MAGIC, 8);
+    putLittleEndian(header + 8, NTUPLE_VERSION, 4);
+    putLittleEndian(header + 12, NTUPLE_COUNT, 4);
+    putLittleEndian(header + 16, NTUPLE_LENGTH, 4);
+    memcpy(header + 28, ntupleCells, sizeof(ntupleCells));
+    for (t = 0; t < NTUPLE_COUNT; t++) {
+        for (s = 0; s < NTUPLE_SYMMETRIES; s++) {
+            for (i = 0; i < NTUPLE_LENGTH; i++) {
+                x = ntupleCells[t][i] / SIZE;
+                y = ntupleCells[t][i] % SIZE;
+                if (s & 4) {
+                    swap = x;
+                    x = y;
+                    y = swap;
+                }
+                x = s & 1 ? SIZE - 1 - x : x;
+                y = s & 2 ? SIZE - 1 - y : y;
+                net->shifts[t * NTUPLE_SYMMETRIES + s][i] = 4 * (SIZE * x + y);
+            }
+        }
+    }
+
+    if (path == NULL) {
+        // a private mapping of /dev/zero is anonymous memory that is only touched pages deep
+        fd = open("/dev/zero", O_RDWR);
+        net->map = fd < 0 ? MAP_FAILED : mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (fd >= 0) {
+            close(fd);
+        }
+    } else {
+        fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        if (writable && info.st_size == 0) {
+            // a sparse file, the tables start at zero
+            if (write(fd, header, sizeof(header)) != (ssize_t) sizeof(header) || ftruncate(fd, length) != 0) {
+                close(fd);
+                return false;
+            }
+            info.st_size = length;
+        }
+        net->map = (size_t) info.st_size != length ? MAP_FAILED
+                   : mmap(NULL, length, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    if (net->map == MAP_FAILED) {
+        net->map = NULL;
+        return false;
+    }
+    net->length = length;
+    if (path == NULL) {
+        memcpy(net->map, header, sizeof(header));
+    }
+    // the game count may differ, the layout may not
+    if (memcmp(net->map, header, 20) != 0 || memcmp(net->map + 28, header + 28, sizeof(ntupleCells)) != 0) {
+        munmap(net->map, length);
+        net->map = NULL;
+        return false;
+    }
+    posix_madvise(net->map, length, POSIX_MADV_RANDOM);
+    net->weights = (float *) (net->map + NTUPLE_HEADER_SIZE);
+    return true;
+}
+
+/**
+ * @brief                       학습한 내용을 파일에 기록하고 매핑을 해제한다.
+ */
+void closeTuples(NTuple *net)
+{
+    if (net->map != NULL) {
+        msync(net->map, net->length, MS_SYNC);
+        munmap(net->map, net->length);
+    }
+    net->map = NULL;
+    net->weights = NULL;
+}
+
+/**
+ * @brief                       tuple 과 대칭 f 가 보는 게임판 b 의 칸들로 테이블 인덱스를 만든다.
+ */
+static ALWAYS_INLINE size_t tupleIndex(const NTuple *net, board_t b, unsigned int f)
+{
+    const uint8_t *shifts = net->shifts[f];
+    size_t index = 0;
+    unsigned int i;
+
+    for (i = 0; i < NTUPLE_LENGTH; i++) {
+        index |= (size_t) ((b >> shifts[i]) & 0xF) << (4 * i);
+    }
+    return (f / NTUPLE_SYMMETRIES) * NTUPLE_ENTRIES + index;
+}
+
+/**
+ * @brief                       게임판의 가치 (앞으로 얻을 점수의 추정값)
+ * @remark                      다른 스레드가 학습 중일 수 있으므로 가중치는 relaxed atomic 으로 읽는다.
+ *                              x86 에서는 보통의 load 와 같은 명령이다.
+ */
+float tupleValue(const NTuple *net, board_t b)
+{
+    float value = 0, weight;
+    unsigned int f;
+
+    for (f = 0; f < NTUPLE_COUNT * NTUPLE_SYMMETRIES; f++) {
+        __atomic_load(&net->weights[tupleIndex(net, b, f)], &weight, __ATOMIC_RELAXED);
+        value += weight;
+    }
+    return value;
+}
+
+/**
+ * @brief                       게임판 b 가 보는 가중치마다 delta 를 더한다.
+ * @remark                      잠금 없이 relaxed atomic 으로 읽고 쓰므로 (Hogwild 방식) 여러 스레드가 같은
+ *                              가중치를 동시에 고치면 드물게 한쪽의 갱신이 사라지지만, 테이블이 크고
+ *                              접근이 흩어져 있어서 학습에는 영향이 거의 없다.
+ */
+void updateTuples(NTuple *net, board_t b, float delta)
+{
+    float *weight;
+    float value;
+    unsigned int f;
+
+    for (f = 0; f < NTUPLE_COUNT * NTUPLE_SYMMETRIES; f++) {
+        weight = &net->weights[tupleIndex(net, b, f)];
+        __atomic_load(weight, &value, __ATOMIC_RELAXED);
+        value += delta;
+        __atomic_store(weight, &value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief                       얻는 점수와 이동한 게임판의 가치의 합이 가장 큰 방향을 고른다.
+ * @param board_t after         선택한 방향으로 이동한 게임판 (새 블럭 추가 전) 을 저장할 변수
+ * @param unsigned int gained   선택한 이동으로 얻는 점수를 저장할 변수
+ * @param float value           선택한 게임판의 가치를 저장할 변수
+ * @return int                  선택한 방향, 움직일 수 있는 방향이 없으면 -1
+ */
+int findTupleMove(const NTuple *net, board_t b, board_t *after, unsigned int *gained, float *value)
+{
+    board_t moved;
+    unsigned int d, score;
+    float v, best = 0;
+    int bestMove = -1;
+
+    for (d = 0; d < MOVE_COUNT; d++) {
+        score = 0;
+        moved = packedMove(b, d, &score);
+        if (moved == b) {
+            continue;
+        }
+        v = tupleValue(net, moved);
+        if (bestMove < 0 || score + v > best) {
+            best = score + v;
+            bestMove = d;
+            *after = moved;
+            *gained = score;
+            *value = v;
+        }
+    }
+    return bestMove;
+}
+
+/**
+ * @brief                       학습 스레드 하나의 작업과 진행 상황
+ * @remark                      진행 상황은 출력하는 스레드가 읽으므로 relaxed atomic 으로 고친다.
+ */
+typedef struct {
+    NTuple *net;
+    float alpha;
+    unsigned long count;
+    uint64_t rng;
+    unsigned long games;
+    unsigned long long score;
+    unsigned long wins;
+    pthread_t thread;
+    bool started;
+    char padding[64];
+} TrainWorker;
+
+/**
+ * @brief                       TD(0) 로 학습하면서 게임 한 판을 진행한다.
+ * @remark                      이동한 게임판 (afterstate) 의 가치를 배운다. 다음 차례에서 고른 이동의
+ *                              점수와 그 게임판의 가치를 목표로 삼고, 게임이 끝나면 목표는 0 이다.
+ * @return unsigned int         최종 점수
+ */
+static unsigned int trainGame(TrainWorker *worker, board_t *last)
+{
+    NTuple *net = worker->net;
+    board_t b = packedAddRandom(packedAddRandom(0, &worker->rng), &worker->rng);
+    board_t after, previous = 0;
+    unsigned int gained, score = 0;
+    float value, previousValue = 0;
+    bool started = false;
+
+    while (findTupleMove(net, b, &after, &gained, &value) >= 0) {
+        if (started) {
+            updateTuples(net, previous, worker->alpha * (gained + value - previousValue));
+        }
+        previous = after;
+        previousValue = value;
+        started = true;
+        score += gained;
+        b = packedAddRandom(after, &worker->rng);
+    }
+    if (started) {
+        updateTuples(net, previous, -worker->alpha * previousValue);
+    }
+    *last = b;
+    return score;
+}
+
+static void *trainWorker(void *arg)
+{
+    TrainWorker *worker = arg;
+    unsigned long i;
+    unsigned int score;
+    board_t b;
+
+    for (i = 0; i < worker->count; i++) {
+        score = trainGame(worker, &b);
+        __atomic_fetch_add(&worker->score, score, __ATOMIC_RELAXED);
+        // 2^11 = 2048
+        __atomic_fetch_add(&worker->wins, packedMaxTile(b) >= 11, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&worker->games, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/**
+ * @brief                       자기 자신과 게임을 하면서 n-tuple 가치 함수를 학습한다.
+ *                              --games N, --threads N, --alpha A, --seed N, --weights FILE
+ * @remark                      모든 스레드가 매핑된 같은 테이블을 잠금 없이 고친다. 1초마다 그 사이에 끝난
+ *                              게임의 평균 점수, 2048 도달 비율과 게임 속도를 출력한다.
+ *                              가중치 파일이 이미 있으면 이어서 학습한다.
+ * @param int argc              "train" 이후 실행 파라미터의 개수
+ * @param int argv              "train" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int train(int argc, char *argv[])
+{
+    const char *path = NTUPLE_DEFAULT_WEIGHTS;
+    const struct timespec pause = {0, 100000000L};
+    NTuple net;
+    TrainWorker *workers;
+    struct timespec start;
+    double seconds, reportedSeconds = 0;
+    unsigned long games = 100000, done, reported = 0, wins, reportedWins = 0;
+    unsigned long long score, reportedScore = 0;
+    unsigned int threads = onlineProcessors();
+    uint64_t seed = time(NULL);
+    float alpha = NTUPLE_DEFAULT_ALPHA;
+    unsigned long first = 0;
+    unsigned int t;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--games") == 0) {
+            games = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--alpha") == 0) {
+            alpha = strtof(argv[++i], NULL);
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--weights") == 0) {
+            path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: 2048 train [--games N] [--threads N] [--alpha A] [--seed N] [--weights FILE]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    initMoveTables();
+    if (!openTuples(&net, path, true)) {
+        fprintf(stderr, "cannot open %s as a weight file\n", path);
+        return EXIT_FAILURE;
+    }
+    workers = calloc(threads, sizeof(workers[0]));
+    if (workers == NULL) {
+        closeTuples(&net);
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (t = 0; t < threads; t++) {
+        workers[t].net = &net;
+        // every game updates each of the features the value is the sum of
+        workers[t].alpha = alpha / (NTUPLE_COUNT * NTUPLE_SYMMETRIES);
+        workers[t].count = games * (t + 1) / threads - first;
+        workers[t].rng = seedRandom(seed, t);
+        first += workers[t].count;
+        workers[t].started = pthread_create(&workers[t].thread, NULL, trainWorker, &workers[t]) == 0;
+        if (!workers[t].started) {
+            trainWorker(&workers[t]);
+        }
+    }
+    do {
+        nanosleep(&pause, NULL);
+        seconds = elapsedSeconds(&start);
+        done = 0;
+        score = 0;
+        wins = 0;
+        for (t = 0; t < threads; t++) {
+            done += __atomic_load_n(&workers[t].games, __ATOMIC_RELAXED);
+            score += __atomic_load_n(&workers[t].score, __ATOMIC_RELAXED);
+            wins += __atomic_load_n(&workers[t].wins, __ATOMIC_RELAXED);
+        }
+        if (done == reported || (seconds - reportedSeconds < 1.0 && done < games)) {
+            continue;
+        }
+        printf("games %10lu  mean score %9.1f  reached 2048 %5.1f%%  games/sec %8.1f\n", done,
+               (double) (score - reportedScore) / (done - reported),
+               100.0 * (wins - reportedWins) / (done - reported), done / seconds);
+        fflush(stdout);
+        reported = done;
+        reportedScore = score;
+        reportedWins = wins;
+        reportedSeconds = seconds;
+    } while (done < games);
+    for (t = 0; t < threads; t++) {
+        if (workers[t].started) {
+            pthread_join(workers[t].thread, NULL);
+        }
+    }
+    // the header keeps the total over all runs
+    putLittleEndian(net.map + 20, getLittleEndian(net.map + 20, 8) + games, 8);
+    printf("trained %llu games into %s\n", (unsigned long long) getLittleEndian(net.map + 20, 8), path);
+    closeTuples(&net);
+    free(workers);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief                       n-tuple 가치 함수가 게임판의 대칭에 대해 같은 값을 주고 갱신이 반영되는지 확인한다.
+ * @return bool                 전치하거나 뒤집은 게임판의 가치가 같고 갱신한 만큼 바뀌면 true
+ */
+bool testTuples(void)
+{
+    // all cells differ, so no two features share a weight
+    const board_t b = 0x7F3E2D1C0B5A4968ULL;
+    board_t mirrored = 0;
+    NTuple net;
+    unsigned int x;
+    bool success;
+
+    if (!openTuples(&net, NULL, true)) {
+        return false;
+    }
+    for (x = 0; x < SIZE; x++) {
+        mirrored |= (board_t) reverseRow((uint16_t) (b >> (16 * x))) << (16 * x);
+    }
+    updateTuples(&net, b, 0.5f);
+    // every one of the features moves by the delta
+    success = fabsf(tupleValue(&net, b) - 0.5f * NTUPLE_COUNT * NTUPLE_SYMMETRIES) < 1e-3f
+              && tupleValue(&net, transposeBoard(b)) == tupleValue(&net, b)
+              && tupleValue(&net, mirrored) == tupleValue(&net, b)
+              && tupleValue(&net, 0x0000000000001111ULL) == 0;
+    closeTuples(&net);
+    return success;
+}
+
+/**
+ * @brief                       playout 스레드 풀이 모든 작업을 정확히 한 번씩 처리하는지 확인한다.
+ * @return bool                 끝난 게임판에서는 -1, 아니면 움직일 수 있는 방향을 고르고 playout 수가 맞으면 true
+ */
+bool testRollouts(void)
+{
+    // a checkerboard of 2s and 4s cannot move
+    const board_t ended = 0x1212212112122121ULL;
+    const board_t b = 0x0000000000120021ULL;
+    RolloutPool pool;
+    float scores[MOVE_COUNT];
+    unsigned int gained, d, legal = 0;
+    int move;
+    bool success;
+
+    if (!initRolloutPool(&pool, 3, 60000, 2 * ROLLOUT_CHUNK, 1)) {
+        return false;
+    }
+    for (d = 0; d < MOVE_COUNT; d++) {
+        gained = 0;
+        legal += packedMove(b, d, &gained) != b;
+    }
+    move = findRolloutMove(&pool, b, scores);
+    gained = 0;
+    success = findRolloutMove(&pool, ended, NULL) == -1 && move >= 0
+              && packedMove(b, move, &gained) != b && scores[move] > 0
+              && rolloutPlayouts(&pool) == legal * 2 * ROLLOUT_CHUNK;
+    freeRolloutPool(&pool);
+    return success;
+}
+
+/**
+ * @brief ai 플레이어가 이동을 고르는 방법 상수입니다
+ */
+#define AI_EXPECTIMAX                0
+#define AI_MCTS                      1
+#define AI_NTUPLE                    2
+#define AI_TABLEBASE                 3
+
+/**
+ * @brief                       기대값 탐색, 무작위 playout 또는 학습한 n-tuple 가치 함수로 게임을 진행하고
+ *                              결과와 속도를 출력한다.
+ *                              --games N, --seed N, --policy expectimax|mcts|ntuple|tablebase,
+ *                              mcts 에서는 --threads N, --budget MS (결정 하나의 최대 시간), --playouts N (방향마다),
+ *                              ntuple 에서는 --weights FILE (train 으로 만든 가중치 파일),
+ *                              tablebase 에서는 --tablebase FILE (3x3 게임판으로 tablebase 의 목표 블럭까지 진행)
+ * @param int argc              "ai" 이후 실행 파라미터의 개수
+ * @param int argv              "ai" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int playAI(int argc, char *argv[])
+{
+    const char *policies[] = {"expectimax", "mcts", "ntuple", "tablebase"};
+    const char *weights = NTUPLE_DEFAULT_WEIGHTS;
+    const char *tablePath = TABLE_DEFAULT_FILE;
+    Search search;
+    RolloutPool pool;
+    NTuple net;
+    Tablebase table;
+    struct timespec start;
+    unsigned long games = 1, wins = 0, g;
+    unsigned long long decisions = 0;
+    uint64_t seed = time(NULL);
+    uint64_t rng;
+    unsigned int score, moves, gained;
+    unsigned int threads = onlineProcessors();
+    unsigned int budget = ROLLOUT_DEFAULT_BUDGET;
+    unsigned int playouts = ROLLOUT_DEFAULT_PLAYOUTS;
+    unsigned int policy = AI_EXPECTIMAX;
+    // 2^11 = 2048
+    unsigned int goal = 11;
+    double seconds;
+    board_t b, after;
+    float value;
+    int i, d;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--games") == 0) {
+            games = strtoul(argv[++i], NULL, 10);
+            // the summary divides by the number of games
+            if (games < 1) {
+                argc = -1;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+            threads = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--budget") == 0) {
+            budget = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--playouts") == 0) {
+            playouts = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "--weights") == 0) {
+            weights = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--tablebase") == 0) {
+            tablePath = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--policy") == 0) {
+            i++;
+            for (policy = 0; policy < sizeof(policies) / sizeof(policies[0]); policy++) {
+                if (strcmp(argv[i], policies[policy]) == 0) {
+                    break;
+                }
+            }
+            if (policy == sizeof(policies) / sizeof(policies[0])) {
+                argc = -1;
+            }
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0) {
+        fprintf(stderr, "usage: 2048 ai [--games N] [--seed N] [--policy expectimax|mcts|ntuple|tablebase] [--threads N] [--budget MS] [--playouts N] [--weights FILE] [--tablebase FILE]\n");
+        return EXIT_FAILURE;
+    }
+    if (policy == AI_MCTS && (playouts == 0 || !initRolloutPool(&pool, threads, budget, playouts, seed))) {
+        fprintf(stderr, "cannot start %u playout threads\n", threads);
+        return EXIT_FAILURE;
+    }
+    if (policy == AI_NTUPLE) {
+        initMoveTables();
+        if (!openTuples(&net, weights, false)) {
+            fprintf(stderr, "cannot load %s, create it with ./2048 train\n", weights);
+            return EXIT_FAILURE;
+        }
+    }
+    if (policy == AI_TABLEBASE) {
+        if (!openTablebase(&table, tablePath)) {
+            fprintf(stderr, "cannot load %s, create it with ./2048 tablebase\n", tablePath);
+            return EXIT_FAILURE;
+        }
+        goal = table.target;
+    }
+    if (policy == AI_EXPECTIMAX && !initSearch(&search)) {
+        fprintf(stderr, "cannot allocate the transposition table\n");
+        return EXIT_FAILURE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (g = 0; g < games; g++) {
+        rng = seedRandom(seed, g);
+        if (policy == AI_TABLEBASE) {
+            b = smallAddRandom(smallAddRandom(0, &rng), &rng);
+        } else {
+            b = packedAddRandom(packedAddRandom(0, &rng), &rng);
+        }
+        score = 0;
+        moves = 0;
+        for (;;) {
+            if (policy == AI_TABLEBASE) {
+                // stops at the target tile, where the tablebase ends
+                d = findTableMove(&table, b, NULL);
+            } else if (policy == AI_MCTS) {
+                d = findRolloutMove(&pool, b, NULL);
+            } else if (policy == AI_NTUPLE) {
+                d = findTupleMove(&net, b, &after, &gained, &value);
+            } else {
+                d = findBestMove(&search, b, NULL);
+            }
+            if (d < 0) {
+                break;
+            }
+            gained = 0;
+            if (policy == AI_TABLEBASE) {
+                b = smallAddRandom(smallMove(b, d, &gained), &rng);
+            } else {
+                b = packedAddRandom(packedMove(b, d, &gained), &rng);
+            }
+            score += gained;
+            moves++;
         }
+        decisions += moves;
+        wins += packedMaxTile(b) >= goal;
+        printf("game %lu: score %u, max tile %u, moves %u\n", g + 1, score, 1u << packedMaxTile(b), moves);
+    }
+    seconds = elapsedSeconds(&start);
+    printf("reached %-7u%lu/%lu (%.1f%%)\n", 1u << goal, wins, games, 100.0 * wins / games);
+    printf("decisions/sec  %.1f\n", decisions / seconds);
+    if (policy == AI_MCTS) {
+        printf("playouts/sec   %.1f\n", rolloutPlayouts(&pool) / seconds);
+        printf("threads        %u\n", pool.threads);
+        freeRolloutPool(&pool);
+    } else if (policy == AI_NTUPLE) {
+        printf("trained games  %llu\n", (unsigned long long) getLittleEndian(net.map + 20, 8));
+        closeTuples(&net);
+    } else if (policy == AI_TABLEBASE) {
+        printf("expected       %.1f%%\n", 100.0 * tableStartValue(&table));
+        closeTablebase(&table);
+    } else {
+        printf("nodes/sec      %.1f\n", search.nodes / seconds);
+        printf("table hits     %.1f%%\n", 100.0 * search.hits / (search.nodes + search.hits));
+        freeSearch(&search);
     }
-    addRandom(board);
-    addRandom(board);
-    drawBoard(board);
-    score = 0;
+    return EXIT_SUCCESS;
 }
 
 /**
- * @author                      조유신 (cho8wola@sju.ac.kr)
- * @brief                       버퍼 인풋을 설정하는 함수
+ * @brief 세션 서버 상수입니다
+ * @remark 텍스트 명령은 한 줄에 하나씩 ("\n" 으로 끝남) 보낸다.
+ *           new [SEED]          새 게임을 만든다. SEED 가 없으면 서버의 --seed 에서 이어지는 값
+ *           move ID DIRS        DIRS 의 방향 (u, d, l, r) 을 차례로 적용한다. 움직이지 않는 방향은 건너뛰고
+ *                               게임이 끝나면 나머지를 버린다.
+ *           query ID            게임판과 점수를 돌려준다.
+ *           undo ID             마지막 이동을 되돌린다. (새 블럭과 난수 상태도 이동 전으로 돌아간다)
+ *                               세션마다 되돌리기 기록 (History) 에 SERVE_HISTORY_STEPS 단계까지 남는다.
+ *           redo ID             undo 로 되돌린 이동을 다시 한다. 새 이동을 하면 다시 할 수 없다.
+ *           close ID            세션을 닫는다.
+ *         응답은 한 줄에 하나씩 "ok ID BOARD SCORE MOVED ENDED" 또는 "err MESSAGE" 이고,
+ *         BOARD 는 board_t 16진수 16자리, MOVED 는 이번 명령으로 움직인 횟수, ENDED 는 0 또는 1 이다.
+ *         바이너리 명령은 명령 (SERVE_NEW ~ SERVE_REDO, 1), ID (4), 길이 (2), 내용 (길이) 이다.
+ *         첫 바이트가 SERVE_BINARY 이상이므로 한 연결에서 텍스트 명령과 섞어 쓸 수 있다.
+ *         new 의 내용은 SEED (8) 또는 없음, move 의 내용은 이동 하나당 한 바이트 (MOVE_UP ~ MOVE_RIGHT) 이다.
+ *         응답은 SERVE_RESPONSE_SIZE 바이트: 상태 (0 이면 ok, 1), ID (4), 게임판 (8), 점수 (4), MOVED (2), ENDED (1)
+ *         수는 모두 little endian 이다.
  */
-void setBufferedInput(bool enable)
+#define SERVE_DEFAULT_SOCKET         "2048.sock"
+#define SERVE_BINARY                 0x80
+#define SERVE_NEW                    0x80
+#define SERVE_MOVE                   0x81
+#define SERVE_QUERY                  0x82
+#define SERVE_UNDO                   0x83
+#define SERVE_CLOSE                  0x84
+#define SERVE_REDO                   0x85
+#define SERVE_HISTORY_STEPS          64
+#define SERVE_HEADER_SIZE            7
+#define SERVE_RESPONSE_SIZE          20
+#define SERVE_LINE_LIMIT             65536
+#define SERVE_OUTPUT_LIMIT           (1 << 20)
+#define SERVE_READ_SIZE              65536
+#define SERVE_EVENTS                 64
+
+/**
+ * @brief                       서버가 진행하는 게임 하나
+ * @param board                 게임판
+ * @param rng                   새 블럭에 사용하는 난수 상태
+ * @param score                 점수
+ * @param history               게임과 같은 되돌리기/다시 하기 기록, 열려 있는 세션만 할당되어 있다.
+ * @param used                  열려 있는 세션이면 true
+ */
+typedef struct {
+    board_t board;
+    uint64_t rng;
+    unsigned int score;
+    History history;
+    bool used;
+} ServeSession;
+
+/**
+ * @brief                       모든 연결이 함께 쓰는 세션 표
+ * @remark                      세션 ID 는 sessions 의 인덱스이고, 닫힌 세션의 ID 는 freeIds 에 모아 다시 쓴다.
+ * @param count                 한 번이라도 쓴 세션 수
+ * @param freeCount             freeIds 에 있는 ID 수
+ * @param open                  열려 있는 세션 수
+ * @param seed                  SEED 없이 만든 세션의 난수 초기값, created 번째로 만든 세션은 seedRandom(seed, created)
+ * @param created               지금까지 만든 세션 수
+ */
+typedef struct {
+    ServeSession *sessions;
+    uint32_t *freeIds;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t freeCount;
+    uint32_t open;
+    uint64_t seed;
+    uint64_t created;
+} Server;
+
+/**
+ * @brief                       클라이언트 연결 하나
+ * @param input                 아직 처리하지 않은 명령 (마지막 명령은 덜 받았을 수 있다)
+ * @param output                보낼 응답, sent 바이트까지는 이미 보냈다.
+ * @param events                epoll 에 등록한 이벤트
+ * @param slot                  connections 배열에서의 위치
+ * @param closing               클라이언트가 쓰기를 끝냈으면 true, 남은 응답을 보낸 뒤 닫는다.
+ */
+typedef struct {
+    int fd;
+    Buffer input;
+    Buffer output;
+    size_t sent;
+    uint32_t events;
+    unsigned int slot;
+    bool closing;
+} ServeConnection;
+
+static volatile sig_atomic_t serveStopped = 0;
+
+static void stopServing(int signum)
 {
-    static bool enabled = true;
-    static struct termios old;
-    struct termios new;
+    (void) signum;
+    serveStopped = 1;
+}
 
-    if (enable && !enabled) {
-        // restore the former settings
-        tcsetattr(STDIN_FILENO, TCSANOW, &old);
-        // set the new state
-        enabled = true;
-    } 
-    else {
-        if (!enable && enabled) {
-            // get the terminal settings for standard input
-            tcgetattr(STDIN_FILENO, &new);
-            // we want to keep the old setting to restore them at the end
-            old = new;
-            // disable canonical mode (buffered i/o) and local echo
-            new.c_lflag &= (~ICANON & ~ECHO);
-            // set the new settings immediately
-            tcsetattr(STDIN_FILENO, TCSANOW, &new);
-            // set the new state
-            enabled = false;
+void initServer(Server *server, uint64_t seed)
+{
+    memset(server, 0, sizeof(*server));
+    server->seed = seed;
+}
+
+void freeServer(Server *server)
+{
+    uint32_t id;
+
+    for (id = 0; id < server->count; id++) {
+        if (server->sessions[id].used) {
+            freeHistory(&server->sessions[id].history);
         }
     }
+    free(server->sessions);
+    free(server->freeIds);
+    memset(server, 0, sizeof(*server));
 }
 
+static ServeSession *findSession(Server *server, uint32_t id)
+{
+    if (id >= server->count || !server->sessions[id].used) {
+        return NULL;
+    }
+    return &server->sessions[id];
+}
 
 /**
- * @author                      조유신 (cho8wola@sju.ac.kr)
- * @brief                       게임을 테스트하는 함수, 테스트 케이스를 통해 임의의 키보드 입력 이벤트로 검사
- * @return int | boolean
+ * @brief                       새 세션을 만들고 처음 두 블럭을 추가한다.
+ * @return bool                 메모리가 부족하면 false
  */
-int test()
+static bool openSession(Server *server, uint64_t rng, uint32_t *id)
 {
-    unsigned int array[SIZE];
-    unsigned int board[SIZE][SIZE];
-    // 2의 제곱으로 변환 (1=2 2=4 3=8)
-    unsigned int data[] = {
-            0, 0, 0, 1, 1, 0, 0, 0,
-            0, 0, 1, 1, 2, 0, 0, 0,
-            0, 1, 0, 1, 2, 0, 0, 0,
-            1, 0, 0, 1, 2, 0, 0, 0,
-            1, 0, 1, 0, 2, 0, 0, 0,
-            1, 1, 1, 0, 2, 1, 0, 0,
-            1, 0, 1, 1, 2, 1, 0, 0,
-            1, 1, 0, 1, 2, 1, 0, 0,
-            1, 1, 1, 1, 2, 2, 0, 0,
-            2, 2, 1, 1, 3, 2, 0, 0,
-            1, 1, 2, 2, 2, 3, 0, 0,
-            3, 0, 1, 1, 3, 2, 0, 0,
-            2, 0, 1, 1, 2, 2, 0, 0
-    };
-    unsigned int *in, *out;
-    unsigned int t, tests;
-    unsigned int i;
-    bool success = true;
+    ServeSession *session;
+    ServeSession *grown;
+    uint32_t *grownIds;
+    uint32_t capacity;
 
-    tests = (sizeof(data) / sizeof(data[0])) / (2 * SIZE);
-    for (t = 0; t < tests; t++) {
-        in = data + t * 2 * SIZE;
-        out = in + SIZE;
-        for (i = 0; i < SIZE; i++) {
-            array[i] = in[i];
-            board[0][i] = in[i];
+    if (server->freeCount > 0) {
+        *id = server->freeIds[--server->freeCount];
+    } else {
+        if (server->count == server->capacity) {
+            capacity = server->capacity > 0 ? 2 * server->capacity : 1024;
+            grown = realloc(server->sessions, capacity * sizeof(*grown));
+            if (grown == NULL) {
+                return false;
+            }
+            server->sessions = grown;
+            grownIds = realloc(server->freeIds, capacity * sizeof(*grownIds));
+            if (grownIds == NULL) {
+                return false;
+            }
+            server->freeIds = grownIds;
+            server->capacity = capacity;
         }
-        slideArray(board, 0);
-        for (i = 0; i < SIZE; i++) {
-            if (board[0][i] != out[i]) {
-                success = false;
+        *id = server->count++;
+    }
+    session = &server->sessions[*id];
+    memset(session, 0, sizeof(*session));
+    if (!initHistory(&session->history, SERVE_HISTORY_STEPS)) {
+        server->freeIds[server->freeCount++] = *id;
+        return false;
+    }
+    session->rng = rng;
+    session->board = packedAddRandom(packedAddRandom(0, &session->rng), &session->rng);
+    savePackedStep(clearHistory(&session->history), session->board, session->rng, 0, MOVE_UP);
+    session->used = true;
+    server->open++;
+    server->created++;
+    return true;
+}
+
+/**
+ * @brief                       세션에 이동들을 차례로 적용한다.
+ * @param uint8_t directions    MOVE_UP ~ MOVE_RIGHT 값들
+ * @return unsigned int         게임판이 바뀐 이동 수
+ */
+static unsigned int playSession(ServeSession *session, const uint8_t *directions, size_t count)
+{
+    unsigned int moved = 0;
+    unsigned int gained;
+    board_t after;
+    size_t i;
+
+    for (i = 0; i < count && openCells(session->board) != 0; i++) {
+        gained = 0;
+        after = packedMove(session->board, directions[i], &gained);
+        if (after == session->board) {
+            continue;
+        }
+        session->board = packedAddRandom(after, &session->rng);
+        session->score += gained;
+        savePackedStep(advanceHistory(&session->history), session->board, session->rng, session->score,
+                       directions[i]);
+        moved++;
+    }
+    return moved;
+}
+
+static bool replyState(Buffer *output, bool binary, uint32_t id, const ServeSession *session, unsigned int moved)
+{
+    uint8_t response[SERVE_RESPONSE_SIZE];
+    char line[80];
+    int length;
+
+    if (binary) {
+        response[0] = 0;
+        putLittleEndian(response + 1, id, 4);
+        putLittleEndian(response + 5, session->board, 8);
+        putLittleEndian(response + 13, session->score, 4);
+        // a binary batch holds at most 65535 moves
+        putLittleEndian(response + 17, moved, 2);
+        response[19] = openCells(session->board) == 0;
+        return appendBuffer(output, response, sizeof(response));
+    }
+    length = snprintf(line, sizeof(line), "ok %u %016llx %u %u %d\n", id, (unsigned long long) session->board,
+                      session->score, moved, openCells(session->board) == 0);
+    return appendBuffer(output, line, length);
+}
+
+static bool replyError(Buffer *output, bool binary, uint32_t id, const char *message)
+{
+    uint8_t response[SERVE_RESPONSE_SIZE] = {1};
+
+    if (binary) {
+        putLittleEndian(response + 1, id, 4);
+        return appendBuffer(output, response, sizeof(response));
+    }
+    return appendBuffer(output, "err ", 4) && appendBuffer(output, message, strlen(message))
+           && appendBuffer(output, "\n", 1);
+}
+
+/**
+ * @brief                       텍스트와 바이너리 명령이 함께 쓰는 명령 처리
+ * @param unsigned int command  SERVE_NEW ~ SERVE_REDO
+ * @param uint64_t rng          SERVE_NEW 가 사용할 난수 상태
+ * @return bool                 응답을 쓸 메모리가 부족하면 false
+ */
+static bool runCommand(Server *server, unsigned int command, uint32_t id, uint64_t rng,
+                       const uint8_t *directions, size_t count, bool binary, Buffer *output)
+{
+    ServeSession *session;
+    const HistoryStep *step;
+    unsigned int moved = 0;
+
+    if (command == SERVE_NEW) {
+        if (!openSession(server, rng, &id)) {
+            return replyError(output, binary, id, "out of memory");
+        }
+        return replyState(output, binary, id, &server->sessions[id], 0);
+    }
+    session = findSession(server, id);
+    if (session == NULL) {
+        return replyError(output, binary, id, "no such session");
+    }
+    switch (command) {
+        case SERVE_MOVE:
+            moved = playSession(session, directions, count);
+            break;
+        case SERVE_UNDO:
+        case SERVE_REDO:
+            step = command == SERVE_UNDO ? rewindHistory(&session->history) : forwardHistory(&session->history);
+            if (step == NULL) {
+                return replyError(output, binary, id, command == SERVE_UNDO ? "nothing to undo" : "nothing to redo");
             }
+            session->board = step->packed.board;
+            session->rng = step->rng;
+            session->score = step->score;
+            moved = 1;
+            break;
+        case SERVE_CLOSE:
+            freeHistory(&session->history);
+            session->used = false;
+            server->freeIds[server->freeCount++] = id;
+            server->open--;
+            break;
+    }
+    return replyState(output, binary, id, session, moved);
+}
+
+/**
+ * @brief                       텍스트 명령 한 줄을 처리한다.
+ * @param char line             "\n" 을 뺀 명령, 처리하는 동안 바뀐다.
+ */
+static bool runTextCommand(Server *server, char *line, Buffer *output)
+{
+    static const char *const commands[] = {"new", "move", "query", "undo", "close", "redo"};
+    static const char directionKeys[] = "udlr";
+    char *save = NULL;
+    char *word = strtok_r(line, " \t\r", &save);
+    char *argument, *end, *key;
+    unsigned int command;
+    unsigned long long value = 0;
+    uint64_t rng;
+    size_t count = 0;
+
+    if (word == NULL) {
+        // blank lines keep the connection alive without an answer
+        return true;
+    }
+    for (command = 0; command < sizeof(commands) / sizeof(commands[0]); command++) {
+        if (strcmp(word, commands[command]) == 0) {
+            break;
         }
-        if (success == false) {
-            for (i = 0; i < SIZE; i++) {
-                printf("%d ", in[i]);
+    }
+    if (command == sizeof(commands) / sizeof(commands[0])) {
+        return replyError(output, false, 0, "unknown command");
+    }
+    command += SERVE_NEW;
+    argument = strtok_r(NULL, " \t\r", &save);
+    if (argument != NULL) {
+        errno = 0;
+        value = strtoull(argument, &end, 10);
+        if (*end != '\0' || errno != 0 || (command != SERVE_NEW && value > UINT32_MAX)) {
+            return replyError(output, false, 0, "bad number");
+        }
+    } else if (command != SERVE_NEW) {
+        return replyError(output, false, 0, "missing session");
+    }
+    if (command == SERVE_NEW) {
+        rng = argument != NULL ? seedRandom(value, 0) : seedRandom(server->seed, server->created);
+        return runCommand(server, command, 0, rng, NULL, 0, false, output);
+    }
+    argument = strtok_r(NULL, " \t\r", &save);
+    if (command == SERVE_MOVE && argument != NULL) {
+        // the directions are turned into move constants in place
+        for (count = 0; argument[count] != '\0'; count++) {
+            key = strchr(directionKeys, argument[count]);
+            if (key == NULL) {
+                return replyError(output, false, (uint32_t) value, "bad direction");
             }
-            printf("=> ");
-            for (i = 0; i < SIZE; i++) {
-                printf("%d ", array[i]);
+            argument[count] = (char) (key - directionKeys);
+        }
+    }
+    return runCommand(server, command, (uint32_t) value, 0, (const uint8_t *) argument, count, false, output);
+}
+
+/**
+ * @brief                       input 에 모두 도착한 명령을 처리하고 응답을 output 에 덧붙인다.
+ * @remark                      처리한 명령은 input 에서 지우고, 덜 도착한 마지막 명령은 남겨 둔다.
+ *                              output 이 SERVE_OUTPUT_LIMIT 이상 쌓이면 나머지 명령은 응답을 보낸 뒤 처리한다.
+ * @return bool                 잘못된 명령이 와서 (또는 메모리가 부족해서) 연결을 끊어야 하면 false
+ */
+bool serveCommands(Server *server, Buffer *input, Buffer *output)
+{
+    uint8_t *p = input->data;
+    uint8_t *end = input->data + input->length;
+    uint8_t *newline;
+    unsigned int command;
+    uint32_t id;
+    size_t length;
+    uint64_t rng;
+    bool ok = true;
+
+    while (ok && p < end && output->length < SERVE_OUTPUT_LIMIT) {
+        if (*p >= SERVE_BINARY) {
+            command = *p;
+            if (command > SERVE_REDO) {
+                return false;
             }
-            printf("expected ");
-            for (i = 0; i < SIZE; i++) {
-                printf("%d ", in[i]);
+            if (end - p < SERVE_HEADER_SIZE) {
+                break;
             }
-            printf("=> ");
-            for (i = 0; i < SIZE; i++) {
-                printf("%d ", out[i]);
+            id = (uint32_t) getLittleEndian(p + 1, 4);
+            length = (size_t) getLittleEndian(p + 5, 2);
+            if ((size_t) (end - p) < SERVE_HEADER_SIZE + length) {
+                break;
+            }
+            if (command == SERVE_NEW && length != 0 && length != 8) {
+                ok = replyError(output, true, id, "bad seed");
+            } else {
+                rng = length == 8 ? seedRandom(getLittleEndian(p + SERVE_HEADER_SIZE, 8), 0)
+                                  : seedRandom(server->seed, server->created);
+                ok = runCommand(server, command, id, rng, p + SERVE_HEADER_SIZE, length, true, output);
+            }
+            p += SERVE_HEADER_SIZE + length;
+            continue;
+        }
+        newline = memchr(p, '\n', end - p);
+        if (newline == NULL) {
+            if (end - p > SERVE_LINE_LIMIT) {
+                return false;
+            }
+            break;
+        }
+        *newline = '\0';
+        ok = runTextCommand(server, (char *) p, output);
+        p = newline + 1;
+    }
+    length = end - p;
+    memmove(input->data, p, length);
+    input->length = length;
+    return ok;
+}
+
+/**
+ * @brief                       연결의 상태에 맞게 epoll 이벤트를 바꾼다.
+ * @remark                      보낼 응답이 많이 쌓였으면 읽기를 멈춰서 클라이언트가 받는 속도에 맞춘다.
+ */
+static void watchConnection(int epoll, ServeConnection *connection)
+{
+    struct epoll_event event;
+    uint32_t events = 0;
+
+    if (!connection->closing && connection->output.length < SERVE_OUTPUT_LIMIT) {
+        events |= EPOLLIN;
+    }
+    if (connection->sent < connection->output.length) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection->events) {
+        event.events = events;
+        event.data.ptr = connection;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->events = events;
+    }
+}
+
+/**
+ * @brief                       쌓인 응답을 보낼 수 있는 만큼 보낸다.
+ * @return bool                 연결이 끊어졌으면 false
+ */
+static bool flushConnection(ServeConnection *connection)
+{
+    ssize_t written;
+
+    while (connection->sent < connection->output.length) {
+        written = send(connection->fd, connection->output.data + connection->sent,
+                       connection->output.length - connection->sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection->sent += written;
+    }
+    connection->output.length = 0;
+    connection->sent = 0;
+    return true;
+}
+
+/**
+ * @brief                       연결에 온 이벤트를 처리한다.
+ * @return bool                 연결을 닫아야 하면 false
+ */
+static bool serviceConnection(Server *server, ServeConnection *connection, uint32_t events)
+{
+    uint8_t chunk[SERVE_READ_SIZE];
+    ssize_t received;
+    bool held;
+
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection->closing) {
+        received = recv(connection->fd, chunk, sizeof(chunk), 0);
+        if (received == 0) {
+            connection->closing = true;
+        } else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return false;
+        } else if (received > 0 && !appendBuffer(&connection->input, chunk, received)) {
+            return false;
+        }
+    }
+    // commands held back by a full output buffer run as soon as it drains
+    do {
+        if (!serveCommands(server, &connection->input, &connection->output)) {
+            return false;
+        }
+        held = connection->output.length >= SERVE_OUTPUT_LIMIT;
+        if (!flushConnection(connection)) {
+            return false;
+        }
+    } while (held && connection->output.length == 0);
+    return !connection->closing || connection->output.length > 0;
+}
+
+static void closeConnection(ServeConnection **connections, unsigned int *count, ServeConnection *connection)
+{
+    close(connection->fd);
+    freeBuffer(&connection->input);
+    freeBuffer(&connection->output);
+    connections[connection->slot] = connections[--*count];
+    connections[connection->slot]->slot = connection->slot;
+    free(connection);
+}
+
+/**
+ * @brief                       Unix 도메인 소켓에서 여러 게임 세션을 진행하는 서버 ("serve" 실행 모드)
+ * @remark                      스레드 하나가 epoll 로 모든 연결을 처리하고, 세션은 연결과 상관없이 ID 로 찾으므로
+ *                              다른 연결에서 이어서 진행할 수도 있다. 한 번에 받은 명령들은 모두 처리한 뒤
+ *                              응답을 모아 한 번에 보낸다. SIGINT 나 SIGTERM 을 받으면 소켓 파일을 지우고 끝낸다.
+ *                              명령 형식은 SERVE_DEFAULT_SOCKET 위의 설명 참고
+ *                              옵션: --socket PATH, --seed N
+ * @param int argc              "serve" 이후 실행 파라미터의 개수
+ * @param int argv              "serve" 이후 실행 파라미터 값들의 배열
+ * @return int                  소켓을 열지 못하면 EXIT_FAILURE
+ */
+int serve(int argc, char *argv[])
+{
+    const char *path = SERVE_DEFAULT_SOCKET;
+    struct sockaddr_un address;
+    struct epoll_event event, events[SERVE_EVENTS];
+    struct stat status;
+    ServeConnection **connections = NULL, **grown;
+    ServeConnection *connection;
+    unsigned int count = 0, capacity = 0;
+    uint64_t seed = time(NULL);
+    Server server;
+    int listener, epoll, client, ready, i;
+
+    for (i = 0; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--socket") == 0) {
+            path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            argc = -1;
+        }
+    }
+    if (argc < 0 || strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "usage: 2048 serve [--socket PATH] [--seed N]\n");
+        return EXIT_FAILURE;
+    }
+    initMoveTables();
+    initServer(&server, seed);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    // a socket left behind by a server that was killed
+    if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(path);
+    }
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0
+        || listen(listener, SOMAXCONN) != 0) {
+        fprintf(stderr, "cannot listen on %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    epoll = epoll_create1(0);
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0) {
+        fprintf(stderr, "cannot create epoll: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, stopServing);
+    signal(SIGTERM, stopServing);
+    signal(SIGPIPE, SIG_IGN);
+    printf("listening on %s\n", path);
+    fflush(stdout);
+
+    while (!serveStopped) {
+        ready = epoll_wait(epoll, events, SERVE_EVENTS, -1);
+        for (i = 0; i < ready; i++) {
+            connection = events[i].data.ptr;
+            if (connection != NULL) {
+                if (!serviceConnection(&server, connection, events[i].events)) {
+                    closeConnection(connections, &count, connection);
+                } else {
+                    watchConnection(epoll, connection);
+                }
+                continue;
+            }
+            while ((client = accept(listener, NULL, NULL)) >= 0) {
+                if (count == capacity) {
+                    capacity = capacity > 0 ? 2 * capacity : 64;
+                    grown = realloc(connections, capacity * sizeof(*grown));
+                    if (grown == NULL) {
+                        close(client);
+                        capacity = count;
+                        break;
+                    }
+                    connections = grown;
+                }
+                connection = calloc(1, sizeof(*connection));
+                if (connection == NULL) {
+                    close(client);
+                    break;
+                }
+                fcntl(client, F_SETFL, O_NONBLOCK);
+                connection->fd = client;
+                connection->events = EPOLLIN;
+                connection->slot = count;
+                connections[count++] = connection;
+                event.events = EPOLLIN;
+                event.data.ptr = connection;
+                epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event);
             }
-            printf("\n");
-            break;
         }
     }
-    if (success) {
-        printf("All %u tests executed successfully\n", tests);
+
+    while (count > 0) {
+        closeConnection(connections, &count, connections[0]);
     }
-    return !success;
+    free(connections);
+    close(epoll);
+    close(listener);
+    unlink(path);
+    printf("\nsessions  %llu created, %u open\n", (unsigned long long) server.created, server.open);
+    freeServer(&server);
+    return EXIT_SUCCESS;
 }
 
-void signal_callback_handler(int signum)
+/**
+ * @brief                       나눠서 도착한 텍스트와 바이너리 명령을 처리한 결과를 packed 이동과 비교한다.
+ * @return bool                 응답이 모두 예상과 같으면 true
+ */
+bool testServe(void)
 {
-    printf("         TERMINATED         \n");
-    setBufferedInput(true);
-    printf("\033[?25h\033[m");
-    exit(signum);
-}
+    static const uint8_t directions[] = {MOVE_UP, MOVE_DOWN, MOVE_LEFT, MOVE_RIGHT};
+    const char *script = "new 7\nmove 0 udlr\nquery 0\nundo 0\nredo 0\nredo 0\nundo 0\nclose 0\nquery 0\nmove 0 x\n"
+                         "new 9\nundo 0\nclose 0\n";
+    uint8_t frame[SERVE_HEADER_SIZE + MOVE_COUNT] = {SERVE_MOVE, 0, 0, 0, 0, MOVE_COUNT, 0};
+    uint8_t seedFrame[SERVE_HEADER_SIZE + 8] = {SERVE_NEW, 0, 0, 0, 0, 8, 0};
+    Server server;
+    Buffer input = {NULL}, output = {NULL}, expected = {NULL};
+    board_t b, after, before = 0, fresh;
+    uint64_t rng = seedRandom(9, 0);
+    unsigned int score = 0, beforeScore = 0, moved = 0, gained, d;
+    char line[80];
+    bool success;
+
+    initServer(&server, 1);
+    fresh = packedAddRandom(packedAddRandom(0, &rng), &rng);
+    rng = seedRandom(7, 0);
+    b = packedAddRandom(packedAddRandom(0, &rng), &rng);
+    snprintf(line, sizeof(line), "ok 0 %016llx 0 0 %d\n", (unsigned long long) b, openCells(b) == 0);
+    appendBuffer(&expected, line, strlen(line));
+    for (d = 0; d < MOVE_COUNT; d++) {
+        gained = 0;
+        after = packedMove(b, directions[d], &gained);
+        if (after != b) {
+            before = b;
+            beforeScore = score;
+            b = packedAddRandom(after, &rng);
+            score += gained;
+            moved++;
+        }
+    }
+    snprintf(line, sizeof(line), "ok 0 %016llx %u %u 0\n", (unsigned long long) b, score, moved);
+    appendBuffer(&expected, line, strlen(line));
+    snprintf(line, sizeof(line), "ok 0 %016llx %u 0 0\n", (unsigned long long) b, score);
+    appendBuffer(&expected, line, strlen(line));
+    // undo and redo walk the session's history ring, a second redo has nothing left
+    snprintf(line, sizeof(line), "ok 0 %016llx %u 1 0\nok 0 %016llx %u 1 0\nerr nothing to redo\n",
+             (unsigned long long) before, beforeScore, (unsigned long long) b, score);
+    appendBuffer(&expected, line, strlen(line));
+    snprintf(line, sizeof(line), "ok 0 %016llx %u 1 0\nok 0 %016llx %u 0 0\nerr no such session\n",
+             (unsigned long long) before, beforeScore, (unsigned long long) before, beforeScore);
+    appendBuffer(&expected, line, strlen(line));
+    appendBuffer(&expected, "err bad direction\n", strlen("err bad direction\n"));
+    // a new session reuses ID 0 and has nothing to undo
+    snprintf(line, sizeof(line), "ok 0 %016llx 0 0 0\nerr nothing to undo\nok 0 %016llx 0 0 0\n",
+             (unsigned long long) fresh, (unsigned long long) fresh);
+    appendBuffer(&expected, line, strlen(line));
+
+    // the script arrives in two pieces that split a command
+    appendBuffer(&input, script, 9);
+    success = serveCommands(&server, &input, &output) && input.length == 3 && output.length > 0;
+    appendBuffer(&input, script + 9, strlen(script) - 9);
+    success = success && serveCommands(&server, &input, &output) && input.length == 0
+              && output.length == expected.length && memcmp(output.data, expected.data, expected.length) == 0;
 
+    // a binary session opened with the same seed lands on ID 0 again and replays the same moves
+    putLittleEndian(seedFrame + SERVE_HEADER_SIZE, 7, 8);
+    memcpy(frame + SERVE_HEADER_SIZE, directions, MOVE_COUNT);
+    output.length = 0;
+    appendBuffer(&input, seedFrame, sizeof(seedFrame));
+    appendBuffer(&input, frame, sizeof(frame));
+    success = success && serveCommands(&server, &input, &output) && output.length == 2 * SERVE_RESPONSE_SIZE
+              && output.data[SERVE_RESPONSE_SIZE] == 0
+              && getLittleEndian(output.data + SERVE_RESPONSE_SIZE + 5, 8) == b
+              && getLittleEndian(output.data + SERVE_RESPONSE_SIZE + 13, 4) == score
+              && getLittleEndian(output.data + SERVE_RESPONSE_SIZE + 17, 2) == moved;
+    // an unknown binary command closes the connection
+    input.length = 0;
+    appendBuffer(&input, "\xFF", 1);
+    success = success && !serveCommands(&server, &input, &output);
 
+    freeBuffer(&input);
+    freeBuffer(&output);
+    freeBuffer(&expected);
+    freeServer(&server);
+    return success;
+}
 
 /**
  * @author                      조유신 (cho8wola@sju.ac.kr)
  * @brief                       실행 파라미터에 따른 처리를 해주는 함수
  * @param int $argc             명령햅 옵션의 개수
  * @param int $argv             명령행 옵션의 문자열
+ * @param Game game             색깔 스키마 옵션을 저장할 게임
  * @return EXCUTE_TEST_MODE     TEST모드로 실행되었을 경우만 리턴
  */
-int getExecuteMode(int argc, char *argv[])
+int getExecuteMode(int argc, char *argv[], Game *game)
 {
-    if (argc == 2) {
-        if ( strcmp(argv[1], "test") == 0 ) {
-            printf("hello");
-            return EXECUTE_TEST_MODE;
+    unsigned int historySteps = HISTORY_DEFAULT_STEPS;
+    bool restart = false;
+    int i;
+
+    if (argc >= 2 && strcmp(argv[1], "sim") == 0) {
+        return EXECUTE_SIM_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "ai") == 0) {
+        return EXECUTE_AI_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "replay") == 0) {
+        return EXECUTE_REPLAY_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        return EXECUTE_BENCH_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "train") == 0) {
+        return EXECUTE_TRAIN_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+        return EXECUTE_SERVE_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "verify") == 0) {
+        return EXECUTE_VERIFY_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "tablebase") == 0) {
+        return EXECUTE_TABLEBASE_MODE;
+    }
+    if (argc >= 2 && strcmp(argv[1], "stats") == 0) {
+        return EXECUTE_STATS_MODE;
+    }
+    if (argc == 2 && strcmp(argv[1], "test") == 0) {
+        printf("hello");
+        return EXECUTE_TEST_MODE;
+    }
+    for (i = 1; i < argc; i++) {
+        if ( strcmp(argv[i], "blackwhite") == 0) {
+            game->scheme = EXECUTE_COLOR_BLACKWHITE;
+        }
+        if ( strcmp(argv[i], "bluered") == 0) {
+            game->scheme = EXECUTE_COLOR_BLUERED;
+        }
+        if (i + 1 < argc && strcmp(argv[i], "scheme") == 0) {
+            if (!loadColorScheme(argv[++i])) {
+                fprintf(stderr, "cannot read color scheme %s\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            game->scheme = SCHEME_CUSTOM;
+        }
+        if (i + 1 < argc && strcmp(argv[i], "--record") == 0) {
+            game->replay = calloc(1, sizeof(*game->replay));
+            if (game->replay == NULL || (game->replay->file = fopen(argv[++i], "ab")) == NULL) {
+                fprintf(stderr, "cannot record to %s\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            // start a new game so that it is recorded from the first tile
+            restart = true;
         }
-        if ( strcmp(argv[1], "blackwhite") == 0) {
-            scheme = EXECUTE_COLOR_BLACKWHITE;
+        if (i + 1 < argc && strcmp(argv[i], "--size") == 0) {
+            if (!setBoardSize(game, strtoul(argv[++i], NULL, 10))) {
+                fprintf(stderr, "board size must be %d to %d\n", MIN_SIZE, MAX_SIZE);
+                exit(EXIT_FAILURE);
+            }
+            restart = true;
+        }
+        if (i + 1 < argc && strcmp(argv[i], "--delay") == 0) {
+            // milliseconds on the command line, microseconds in the game
+            game->delay = strtoul(argv[++i], NULL, 10) * 1000;
+        }
+        if (i + 1 < argc && strcmp(argv[i], "--history") == 0) {
+            historySteps = strtoul(argv[++i], NULL, 10);
+        }
+        if (strcmp(argv[i], "--stats") == 0) {
+            statsEnabled = true;
+        }
+        if (strcmp(argv[i], "--analysis") == 0 && game->analysis == NULL) {
+            game->analysis = calloc(1, sizeof(*game->analysis));
+            if (game->analysis == NULL || !initAnalysis(game->analysis)) {
+                fprintf(stderr, "cannot start the analysis thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (i + 1 < argc && strcmp(argv[i], "--tablebase") == 0) {
+            game->tablebase = calloc(1, sizeof(*game->tablebase));
+            if (game->tablebase == NULL || !openTablebase(game->tablebase, argv[++i])) {
+                fprintf(stderr, "cannot load tablebase %s\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
         }
-        if ( strcmp(argv[1], "bluered") == 0) {
-            scheme = EXECUTE_COLOR_BLUERED;
+    }
+    if (historySteps > 0) {
+        game->history = calloc(1, sizeof(*game->history));
+        if (game->history == NULL || !initHistory(game->history, historySteps)) {
+            fprintf(stderr, "cannot keep %u undo steps\n", historySteps);
+            exit(EXIT_FAILURE);
         }
+        resetHistory(game->history, game);
+    }
+    if (restart) {
+        initBoard(game);
     }
 
     return EXECUTE_GAME_MODE;
 }
 
+/**
+ * @brief                       아직 처리하지 않은 키 입력을 담는 큐
+ * @param keys                  읽은 키, head 부터 tail 전까지가 처리할 키
+ * @param closed                입력이 끝났거나 읽을 수 없으면 true
+ * @param wake                  입력과 함께 기다리는 파일 (분석 결과의 pipe), 없으면 -1
+ * @param woken                 wake 에 읽을 것이 생겨서 깨어났으면 true
+ */
+typedef struct {
+    unsigned char keys[256];
+    unsigned int head;
+    unsigned int tail;
+    bool closed;
+    int wake;
+    bool woken;
+} InputQueue;
+
+/**
+ * @brief                       입력을 기다렸다가 지금 읽을 수 있는 키를 모두 큐에 넣는다.
+ * @param InputQueue queue      입력 큐, 비어 있을 때만 호출한다.
+ * @param int timeout           기다릴 최대 시간 (밀리초), -1 이면 입력이 올 때까지 기다린다.
+ * @return bool                 읽은 키가 있으면 true, 시간이 지났거나 입력이 끝났거나 wake 로 깨어났으면 false
+ */
+bool fillInput(InputQueue *queue, int timeout)
+{
+    // poll skips a negative descriptor
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {queue->wake, POLLIN, 0}};
+    ssize_t length;
+    int ready;
+
+    queue->head = 0;
+    queue->tail = 0;
+    if (queue->closed) {
+        // nothing more to read, just let the timeout pass
+        if (timeout >= 0) {
+            poll(NULL, 0, timeout);
+        }
+        return false;
+    }
+    ready = poll(fds, 2, timeout);
+    if (ready < 0 && errno != EINTR) {
+        queue->closed = true;
+    }
+    if (ready <= 0) {
+        return false;
+    }
+    queue->woken |= fds[1].revents != 0;
+    if (fds[0].revents == 0) {
+        return false;
+    }
+    length = read(STDIN_FILENO, queue->keys, sizeof(queue->keys));
+    if (length <= 0) {
+        queue->closed = length == 0 || errno != EINTR;
+        return false;
+    }
+    queue->tail = length;
+    return true;
+}
+
+/**
+ * @brief                       큐에서 키 하나를 꺼낸다.
+ * @param bool wait             큐가 비었을 때 입력이 올 때까지 기다릴지 여부
+ * @return int                  꺼낸 키, 없거나 입력이 끝났으면 -1
+ */
+int nextKey(InputQueue *queue, bool wait)
+{
+    while (queue->head == queue->tail) {
+        if (!wait || queue->closed || terminateRequested) {
+            return -1;
+        }
+        fillInput(queue, -1);
+    }
+    return queue->keys[queue->head++];
+}
+
+/**
+ * @brief                       이동이 끝난 게임판에 새 블럭을 추가하고 게임이 끝났는지 확인한다.
+ * @param unsigned int direction 방금 한 이동의 방향 (되돌리기 기록용)
+ * @return bool                 게임이 끝났으면 true
+ */
+bool spawnAfterMove(Game *game, unsigned int direction)
+{
+    uint64_t start = statsClock();
+
+    addRandom(game);
+    if (game->replay != NULL) {
+        recordBoard(game->replay, boardDigest(game));
+    }
+    if (game->history != NULL) {
+        pushHistory(game->history, game, direction);
+    }
+    STAT_PHASE(PHASE_SPAWN, start);
+    if (gameEnded(game)) {
+        drawBoard(game);
+        printf("         GAME OVER          \n");
+        return true;
+    }
+    return false;
+}
+
 /**
  * @author                      조유신 (cho8wola@sju.ac.kr)
  * @brief                       키 입력 이벤트를 처리하는 함수
- * @param unit8_t board         게임의 현재 상황을 나타내는 게임보드
+ * @remark                      입력은 poll 로 기다리고, 이동 후 새 블럭은 game->delay 만큼 지난 뒤
+ *                              타이머로 추가하므로 그동안에도 입력을 받는다. 새 블럭을 기다리는 중에
+ *                              키가 들어오면 새 블럭을 바로 추가하고 그 키를 처리한다.
+ *                              이미 쌓여 있는 키들은 한꺼번에 처리하고 화면은 마지막에 한 번만 그린다.
+ *                              u 는 이동을 되돌리고 Ctrl-R 은 되돌린 이동을 다시 한다. (game->history 가 있을 때)
+ *                              game->analysis 가 있으면 입력을 기다리기 전에 지금 게임판의 분석을 요청하고,
+ *                              분석 스레드가 결과를 넣으면 입력을 기다리다가 깨어나서 화면을 다시 그린다.
+ * @param Game game             진행할 게임
  */
-void KeyInputProcess(unsigned int board[][SIZE])
+void KeyInputProcess(Game *game)
 {
-    char c;
+    Search search = {NULL};
+    InputQueue input = {{0}, 0, 0, false, -1, false};
+    uint64_t spawnAt = 0;
+    uint64_t now, start;
+    bool spawnPending = false;
+    bool dirty = false;
     bool success;
+    unsigned int direction = MOVE_UP;
+    int c, timeout;
 
-    
+    if (game->analysis != NULL) {
+        input.wake = game->analysis->pipe[0];
+    }
     while (true) {
-        c = getchar();
-        if (c == -1) { // @todo -1에 대한 설명 명명된 상수로 대체할 예정
-            puts("\nError! Cannot read keyboard input!");
-            break;
+        c = nextKey(&input, false);
+        if (c < 0) {
+            // Ctrl-C interrupts the poll below, so the flag is seen before waiting again
+            if (terminateRequested) {
+                printf("         TERMINATED         \n");
+                break;
+            }
+            // every queued key has been handled, show the result before waiting
+            if (input.woken) {
+                // the analysis thread has finished another depth
+                input.woken = false;
+                dirty = true;
+            }
+            if (dirty) {
+                drawBoard(game);
+                dirty = false;
+            }
+            if (game->analysis != NULL && !spawnPending && game->size == SIZE) {
+                requestAnalysis(game->analysis, packBoard(game->board));
+            }
+            timeout = -1;
+            if (spawnPending) {
+                now = monotonicNanos();
+                timeout = spawnAt > now ? (int) ((spawnAt - now + 999999) / 1000000) : 0;
+            }
+            // waiting out the spawn delay is sleep, anything else is waiting for the player
+            start = statsClock();
+            if (fillInput(&input, timeout)) {
+                STAT_PHASE(spawnPending ? PHASE_SLEEP : PHASE_INPUT, start);
+                continue;
+            }
+            STAT_PHASE(spawnPending ? PHASE_SLEEP : PHASE_INPUT, start);
+            if (statsRequested) {
+                statsRequested = 0;
+                printStats(stderr);
+            }
+            if (spawnPending && monotonicNanos() >= spawnAt) {
+                spawnPending = false;
+                if (spawnAfterMove(game, direction)) {
+                    break;
+                }
+                dirty = true;
+                continue;
+            }
+            if (input.closed && !spawnPending) {
+                puts("\nError! Cannot read keyboard input!");
+                break;
+            }
+            continue;
+        }
+        if (spawnPending) {
+            // the player did not wait for the animation
+            spawnPending = false;
+            if (spawnAfterMove(game, direction)) {
+                break;
+            }
+            dirty = true;
         }
+        start = statsClock();
         switch (c) {
             case 97:    // 'a' 키
             case 104:    // 'h' 키
             case 68:    // 왼쪽 화살표
-                success = moveLeft(board);
+                direction = MOVE_LEFT;
+                success = moveLeft(game);
                 break;
             case 100:    // 'd' 키
             case 108:    // 'l' 키
             case 67:    // 오른쪽 화살표
-                success = moveRight(board);
+                direction = MOVE_RIGHT;
+                success = moveRight(game);
                 break;
             case 119:    // 'w' 키
             case 107:    // 'k' 키
             case 65:    // 위쪽 화살표
-                success = moveUp(board);
+                direction = MOVE_UP;
+                success = moveUp(game);
                 break;
             case 115:    // 's' 키
             case 106:    // 'j' 키
             case 66:    // 아래쪽 화살표
-                success = moveDown(board);
+                direction = MOVE_DOWN;
+                success = moveDown(game);
+                break;
+            case 117:    // 'u' 키
+                dirty |= undoMove(game);
+                success = false;
+                break;
+            case 18:    // Ctrl-R
+                dirty |= redoMove(game);
+                success = false;
                 break;
             default:
                 success = false;
         }
+        STAT_PHASE(PHASE_MOVE, start);
         if (success) {
-            drawBoard(board);
-            usleep(150000);
-            addRandom(board);
-            drawBoard(board);
-            if (gameEnded(board)) {
-                printf("         GAME OVER          \n");
-                break;
+            if (game->replay != NULL) {
+                recordMove(game->replay, direction);
+            }
+            if (game->delay == 0) {
+                if (spawnAfterMove(game, direction)) {
+                    break;
+                }
+                dirty = true;
+            } else {
+                // show the moved board now if nothing else is queued
+                dirty = true;
+                if (input.head == input.tail) {
+                    drawBoard(game);
+                    dirty = false;
+                }
+                spawnAt = monotonicNanos() + (uint64_t) game->delay * 1000;
+                spawnPending = true;
+            }
+        }
+        if (c == 'q' || c == 'r' || c == 'i') {
+            if (dirty) {
+                drawBoard(game);
+                dirty = false;
             }
         }
         if (c == 'q') {
             printf("        QUIT? (y/n)         \n");
-            c = getchar();
+            fflush(stdout);
+            c = nextKey(&input, true);
             if (c == 'y') {
                 break;
             }
-            drawBoard(board);
+            drawBoard(game);
         }
         if (c == 'r') {
             printf("       RESTART? (y/n)       \n");
-            c = getchar();
+            fflush(stdout);
+            c = nextKey(&input, true);
             if (c == 'y') {
-                initBoard(board);
+                initBoard(game);
+            }
+            drawBoard(game);
+        }
+        if (c == 'i') {
+            printHint(game, &search);
+            fflush(stdout);
+        }
+    }
+    if (game->replay != NULL) {
+        finishReplay(game->replay, boardDigest(game), game->score);
+    }
+    freeSearch(&search);
+}
+
+/**
+ * @brief 벤치마크 상수입니다
+ * @remark 각 항목은 한 번에 BENCH_MIN_NANOS 이상 걸리도록 반복 횟수를 정한 뒤,
+ *         BENCH_WARMUP 번 버리고 reps 번 측정해서 연산 하나당 시간의 중앙값과 p99 를 낸다.
+ */
+#define BENCH_BOARDS                 1024
+#define BENCH_WARMUP                 3
+#define BENCH_REPS                   51
+#define BENCH_MIN_NANOS              200000
+
+/**
+ * @brief                       벤치마크에 사용할 게임판들과 상태
+ * @param boards                게임 중간의 게임판들, 연산마다 하나씩 돌아가며 game 에 복사한다.
+ * @param empty                 boards 마다의 game->empty (pairs 도 같다)
+ * @param work                  묶음 함수들이 사용하는 게임 묶음 (scores, rngs, directions 도 같다)
+ * @param sink                  결과가 최적화로 사라지지 않도록 모으는 값
+ */
+typedef struct {
+    Game game;
+    Screen screen;
+    unsigned int boards[BENCH_BOARDS][MAX_SIZE][MAX_SIZE];
+    uint64_t empty[BENCH_BOARDS];
+    uint64_t pairs[BENCH_BOARDS];
+    board_t packed[BENCH_BOARDS];
+    board_t work[BENCH_BOARDS];
+    unsigned int scores[BENCH_BOARDS];
+    uint64_t rngs[BENCH_BOARDS];
+    uint8_t directions[BENCH_BOARDS];
+    uint64_t mask[BATCH_WORDS(BENCH_BOARDS)];
+    uint64_t ended[BATCH_WORDS(BENCH_BOARDS)];
+    uint64_t rng;
+    unsigned long long sink;
+} BenchContext;
+
+typedef struct {
+    const char *name;
+    void (*run)(BenchContext *context, unsigned long count);
+} Benchmark;
+
+// receives sink once at the end, so the measured loops stay free of volatile accesses
+static volatile unsigned long long benchSink;
+
+static void loadBenchBoard(BenchContext *context, unsigned long i)
+{
+    // only the columns in use, so that smaller boards copy less
+    memcpy(context->game.board, context->boards[i % BENCH_BOARDS], context->game.size * sizeof(context->game.board[0]));
+    context->game.empty = context->empty[i % BENCH_BOARDS];
+    context->game.pairs = context->pairs[i % BENCH_BOARDS];
+}
+
+#define BENCH_GAME(function, expression)                                    \
+    static void function(BenchContext *context, unsigned long count)        \
+    {                                                                       \
+        Game *game = &context->game;                                        \
+        unsigned long i;                                                    \
+        for (i = 0; i < count; i++) {                                       \
+            loadBenchBoard(context, i);                                     \
+            context->sink += (expression);                                  \
+        }                                                                   \
+    }
+
+BENCH_GAME(benchCopy, game->board[0][0])
+BENCH_GAME(benchSlideArray, slideArray(game, i % game->size))
+BENCH_GAME(benchMoveUp, moveUp(game))
+BENCH_GAME(benchMoveDown, moveDown(game))
+BENCH_GAME(benchMoveLeft, moveLeft(game))
+BENCH_GAME(benchMoveRight, moveRight(game))
+BENCH_GAME(benchRotateBoard, (rotateBoard(game), game->board[0][0]))
+BENCH_GAME(benchGameEnded, gameEnded(game))
+BENCH_GAME(benchCountEmpty, countEmpty(game))
+BENCH_GAME(benchAddRandom, (addRandom(game), game->board[0][0]))
+BENCH_GAME(benchDrawFull, (game->screen->valid = false, drawBoard(game), game->screen->length))
+BENCH_GAME(benchDrawDiff, (drawBoard(game), game->screen->length))
+
+static void benchPackedMoves(BenchContext *context, unsigned long count)
+{
+    unsigned int gained = 0;
+    unsigned long i;
+    for (i = 0; i < count; i++) {
+        context->sink += packedMove(context->packed[i % BENCH_BOARDS], i % MOVE_COUNT, &gained);
+    }
+    context->sink += gained;
+}
+
+static void benchPackedAddRandom(BenchContext *context, unsigned long count)
+{
+    unsigned long i;
+    for (i = 0; i < count; i++) {
+        context->sink += packedAddRandom(context->packed[i % BENCH_BOARDS], &context->rng);
+    }
+}
+
+static void benchCanonicalBoard(BenchContext *context, unsigned long count)
+{
+    unsigned long i;
+    for (i = 0; i < count; i++) {
+        context->sink += canonicalBoard(context->packed[i % BENCH_BOARDS], NULL);
+    }
+}
+
+static void benchBoardHash(BenchContext *context, unsigned long count)
+{
+    unsigned long i;
+    for (i = 0; i < count; i++) {
+        context->sink += boardHash(context->packed[i % BENCH_BOARDS]);
+    }
+}
+
+/**
+ * @brief                       게임판 count 개를 BENCH_BOARDS 개씩 묶음으로 복사해서 run 을 실행한다.
+ */
+static void benchBatch(BenchContext *context, unsigned long count, void (*run)(BenchContext *, BoardBatch *))
+{
+    BoardBatch batch = {0, context->work, context->scores, context->rngs};
+    unsigned long done;
+
+    for (done = 0; done < count; done += batch.count) {
+        batch.count = count - done < BENCH_BOARDS ? count - done : BENCH_BOARDS;
+        memcpy(context->work, context->packed, batch.count * sizeof(context->work[0]));
+        run(context, &batch);
+        context->sink += context->work[0];
+    }
+}
+
+static void runBatchMove(BenchContext *context, BoardBatch *batch)
+{
+    batchMove(batch, context->directions, context->mask);
+}
+
+static void runBatchAddRandom(BenchContext *context, BoardBatch *batch)
+{
+    (void) context;
+    batchAddRandom(batch, NULL);
+}
+
+static void runBatchGameEnded(BenchContext *context, BoardBatch *batch)
+{
+    batchGameEnded(batch, context->ended);
+}
+
+static void benchBatchMove(BenchContext *context, unsigned long count)
+{
+    benchBatch(context, count, runBatchMove);
+}
+
+static void benchBatchAddRandom(BenchContext *context, unsigned long count)
+{
+    benchBatch(context, count, runBatchAddRandom);
+}
+
+static void benchBatchGameEnded(BenchContext *context, unsigned long count)
+{
+    benchBatch(context, count, runBatchGameEnded);
+}
+
+/**
+ * @brief                       게임 묶음 하나로 여러 게임을 함께 끝까지 진행한다. (무작위 방향)
+ * @remark                      끝난 게임은 마지막 게임과 자리를 바꿔서 빼므로 묶음이 빈틈없이 유지된다.
+ */
+static void benchBatchGame(BenchContext *context, unsigned long count)
+{
+    BoardBatch batch = {0, context->work, context->scores, context->rngs};
+    unsigned long done, started;
+    size_t i;
+
+    for (done = 0; done < count; done += started) {
+        started = count - done < BENCH_BOARDS ? count - done : BENCH_BOARDS;
+        batch.count = started;
+        for (i = 0; i < batch.count; i++) {
+            context->work[i] = 0;
+            context->scores[i] = 0;
+            context->rngs[i] = seedRandom(nextRandom(&context->rng), i);
+        }
+        batchAddRandom(&batch, NULL);
+        batchAddRandom(&batch, NULL);
+        while (batch.count > 0) {
+            for (i = 0; i < batch.count; i++) {
+                context->directions[i] = randomBelow(&context->rngs[i], MOVE_COUNT);
+            }
+            batchMove(&batch, context->directions, context->mask);
+            batchAddRandom(&batch, context->mask);
+            batchGameEnded(&batch, context->ended);
+            for (i = batch.count; i-- > 0;) {
+                if (context->ended[i / BATCH_BLOCK] >> (i % BATCH_BLOCK) & 1) {
+                    context->sink += context->scores[i];
+                    batch.count--;
+                    context->work[i] = context->work[batch.count];
+                    context->scores[i] = context->scores[batch.count];
+                    context->rngs[i] = context->rngs[batch.count];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief                       배열 게임판으로 게임 한 판을 끝까지 진행한다. (무작위 방향)
+ */
+static void benchGame(BenchContext *context, unsigned long count)
+{
+    bool (*moves[])(Game *) = {moveUp, moveDown, moveLeft, moveRight};
+    Game *game = &context->game;
+    unsigned int d;
+    unsigned long i;
+
+    for (i = 0; i < count; i++) {
+        initBoard(game);
+        do {
+            d = randomBelow(&game->rng, MOVE_COUNT);
+            while (!moves[d](game)) {
+                d = (d + 1) % MOVE_COUNT;
+            }
+            addRandom(game);
+        } while (!gameEnded(game));
+        context->sink += game->score;
+    }
+}
+
+static void benchPackedGame(BenchContext *context, unsigned long count)
+{
+    SimOptions options;
+    SimStats stats;
+    unsigned int score;
+    unsigned long i;
+
+    parseSimOptions(0, NULL, &options);
+    memset(&stats, 0, sizeof(stats));
+    stats.scores = &score;
+    for (i = 0; i < count; i++) {
+        stats.games = 0;
+        simulateGame(&options, &stats, &context->rng, NULL, NULL, NULL);
+    }
+    context->sink += stats.moves;
+}
+
+/**
+ * @brief                       무작위로 한 번 움직이고 블럭을 추가해서 다음 벤치마크 게임판을 만든다.
+ */
+static void nextBenchBoard(Game *game)
+{
+    unsigned int d;
+
+    if (gameEnded(game) || randomBelow(&game->rng, 64) == 0) {
+        initBoard(game);
+    }
+    for (d = randomBelow(&game->rng, MOVE_COUNT); !moveUp(game) && d > 0; d--) {
+        rotateBoard(game);
+    }
+    addRandom(game);
+}
+
+int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief                       엔진의 각 함수와 게임 전체의 속도를 측정해서 출력한다.
+ *                              --reps N, --size N, --csv, --json
+ * @remark                      drawBoard 는 표준 출력을 /dev/null 로 바꾸고 측정한다.
+ *                              --size 는 배열 게임판 함수에만 적용되고 packed 함수는 항상 4x4 이다.
+ * @param int argc              "bench" 이후 실행 파라미터의 개수
+ * @param int argv              "bench" 이후 실행 파라미터 값들의 배열
+ * @return int                  성공하면 EXIT_SUCCESS
+ */
+int bench(int argc, char *argv[])
+{
+    const Benchmark benchmarks[] = {
+        {"copy", benchCopy},
+        {"slideArray", benchSlideArray},
+        {"moveUp", benchMoveUp},
+        {"moveDown", benchMoveDown},
+        {"moveLeft", benchMoveLeft},
+        {"moveRight", benchMoveRight},
+        {"rotateBoard", benchRotateBoard},
+        {"gameEnded", benchGameEnded},
+        {"countEmpty", benchCountEmpty},
+        {"addRandom", benchAddRandom},
+        {"drawBoard", benchDrawFull},
+        {"drawBoard.diff", benchDrawDiff},
+        {"packedMove", benchPackedMoves},
+        {"packedAddRandom", benchPackedAddRandom},
+        {"canonicalBoard", benchCanonicalBoard},
+        {"boardHash", benchBoardHash},
+        {"batchMove", benchBatchMove},
+        {"batchAddRandom", benchBatchAddRandom},
+        {"batchGameEnded", benchBatchGameEnded},
+        {"game", benchGame},
+        {"game.packed", benchPackedGame},
+        {"game.batch", benchBatchGame}
+    };
+    const unsigned int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    BenchContext *context;
+    double samples[1000];
+    double median[sizeof(benchmarks) / sizeof(benchmarks[0])];
+    double p99[sizeof(benchmarks) / sizeof(benchmarks[0])];
+    unsigned long iterations[sizeof(benchmarks) / sizeof(benchmarks[0])];
+    unsigned int reps = BENCH_REPS;
+    unsigned int size = SIZE;
+    unsigned int b, r, i;
+    bool csv = false, json = false;
+    uint64_t start, elapsed;
+    int out, devnull;
+
+    for (i = 0; i < (unsigned int) argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (i + 1 < (unsigned int) argc && strcmp(argv[i], "--reps") == 0) {
+            reps = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < (unsigned int) argc && strcmp(argv[i], "--size") == 0) {
+            size = strtoul(argv[++i], NULL, 10);
+        } else {
+            reps = 0;
+            break;
+        }
+    }
+    if (reps == 0 || reps > sizeof(samples) / sizeof(samples[0]) || size < MIN_SIZE || size > MAX_SIZE) {
+        fprintf(stderr, "usage: 2048 bench [--reps N] [--size N] [--csv | --json]\n");
+        return EXIT_FAILURE;
+    }
+    context = calloc(1, sizeof(*context));
+    if (context == NULL) {
+        return EXIT_FAILURE;
+    }
+    initMoveTables();
+
+    // boards from the middle of random games, so branches are not trivially predictable
+    initGame(&context->game, 1);
+    context->game.screen = &context->screen;
+    setBoardSize(&context->game, size);
+    initBoard(&context->game);
+    for (i = 0; i < BENCH_BOARDS; i++) {
+        nextBenchBoard(&context->game);
+        memcpy(context->boards[i], context->game.board, sizeof(context->boards[i]));
+        context->empty[i] = context->game.empty;
+        context->pairs[i] = context->game.pairs;
+    }
+    if (size != SIZE) {
+        // the packed engine only holds 4x4 boards, so it gets boards of its own
+        setBoardSize(&context->game, SIZE);
+        initBoard(&context->game);
+    }
+    for (i = 0; i < BENCH_BOARDS; i++) {
+        if (size != SIZE) {
+            nextBenchBoard(&context->game);
+        }
+        context->packed[i] = packBoard(size != SIZE ? context->game.board : context->boards[i]);
+    }
+    setBoardSize(&context->game, size);
+    context->rng = seedRandom(1, 1);
+    for (i = 0; i < BENCH_BOARDS; i++) {
+        context->directions[i] = i % MOVE_COUNT;
+        context->rngs[i] = seedRandom(i, 2);
+    }
+
+    // drawBoard writes to the terminal, send it to /dev/null while measuring
+    fflush(stdout);
+    out = dup(STDOUT_FILENO);
+    devnull = open("/dev/null", O_WRONLY);
+    if (out < 0 || devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "cannot redirect the output to /dev/null\n");
+        free(context);
+        return EXIT_FAILURE;
+    }
+    close(devnull);
+
+    for (b = 0; b < count; b++) {
+        // find a count that takes long enough to time reliably
+        for (iterations[b] = 1;; iterations[b] *= 2) {
+            start = monotonicNanos();
+            benchmarks[b].run(context, iterations[b]);
+            if (monotonicNanos() - start >= BENCH_MIN_NANOS) {
+                break;
+            }
+        }
+        for (r = 0; r < BENCH_WARMUP + reps; r++) {
+            start = monotonicNanos();
+            benchmarks[b].run(context, iterations[b]);
+            elapsed = monotonicNanos() - start;
+            if (r >= BENCH_WARMUP) {
+                samples[r - BENCH_WARMUP] = (double) elapsed / iterations[b];
             }
-            drawBoard(board);
+        }
+        qsort(samples, reps, sizeof(samples[0]), compareDoubles);
+        median[b] = samples[reps / 2];
+        p99[b] = samples[reps * 99 / 100];
+    }
+
+    dup2(out, STDOUT_FILENO);
+    close(out);
+
+    if (json) {
+        printf("{\"reps\": %u, \"size\": %u, \"results\": [\n", reps, size);
+    } else if (csv) {
+        printf("name,median_ns,p99_ns,iterations,reps\n");
+    } else {
+        printf("%-18s %14s %14s %12s\n", "name", "median ns/op", "p99 ns/op", "iterations");
+    }
+    for (b = 0; b < count; b++) {
+        if (json) {
+            printf("  {\"name\": \"%s\", \"median_ns\": %.2f, \"p99_ns\": %.2f, \"iterations\": %lu}%s\n",
+                   benchmarks[b].name, median[b], p99[b], iterations[b], b + 1 < count ? "," : "");
+        } else if (csv) {
+            printf("%s,%.2f,%.2f,%lu,%u\n", benchmarks[b].name, median[b], p99[b], iterations[b], reps);
+        } else {
+            printf("%-18s %14.1f %14.1f %12lu\n", benchmarks[b].name, median[b], p99[b], iterations[b]);
         }
     }
+    if (json) {
+        printf("], \"games_per_sec\": %.1f, \"packed_games_per_sec\": %.1f, \"batch_games_per_sec\": %.1f, "
+               "\"vector\": \"%s\"}\n",
+               1e9 / median[count - 3], 1e9 / median[count - 2], 1e9 / median[count - 1], initVectorKernels());
+    } else if (!csv) {
+        printf("games/sec          %14.1f\n", 1e9 / median[count - 3]);
+        printf("packed games/sec   %14.1f\n", 1e9 / median[count - 2]);
+        printf("batch games/sec    %14.1f\n", 1e9 / median[count - 1]);
+        printf("vector moves       %14s\n", initVectorKernels());
+    }
+    // a volatile store is observable, so the compiler must compute every result
+    benchSink = context->sink;
+    free(context);
+    return EXIT_SUCCESS;
 }
 
+#ifdef FUZZ_TARGET
+/**
+ * @brief                       libFuzzer/AFL 입력 하나로 이동 함수들을 기준 이동과 비교한다.
+ * @remark                      -DFUZZ_TARGET 으로 컴파일하면 main 대신 이 함수가 진입점이다. (make fuzz)
+ *                              입력: 게임판 크기 (1, MIN_SIZE + data[0] % 6), 칸마다 지수 (size * size, 아래 4비트),
+ *                              나머지는 이동 하나당 한 바이트 (아래 2비트)
+ *                              매 이동 전에 verifyMoves 로 네 방향을 비교하고 다르면 abort 한다.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static Game game;
+    unsigned int n, x, y;
+    size_t i;
+
+    if (size < 1) {
+        return 0;
+    }
+    initMoveTables();
+    n = MIN_SIZE + data[0] % (MAX_SIZE - MIN_SIZE + 1);
+    memset(game.board, 0, sizeof(game.board));
+    setBoardSize(&game, n);
+    for (i = 1, x = 0; x < n; x++) {
+        for (y = 0; y < n; y++, i++) {
+            game.board[x][y] = i < size ? data[i] & 0xF : 0;
+        }
+    }
+    refreshMasks(&game);
+    game.score = 0;
+    game.rng = seedRandom(0, 0);
+    for (; i < size; i++) {
+        if (verifyMoves(&game) >= 0) {
+            abort();
+        }
+        if (game.kernels->move[data[i] & 3](&game)) {
+            addRandom(&game);
+        }
+    }
+    if (verifyMoves(&game) >= 0) {
+        abort();
+    }
+    return 0;
+}
+#else
 /**
  * @author                      조유신 (cho8wola@sju.ac.kr)
  * @brief                       main함수
@@ -616,24 +8803,48 @@ void KeyInputProcess(unsigned int board[][SIZE])
  */
 int main(int argc, char *argv[])
 {
-    unsigned int board[SIZE][SIZE];
+    Game game;
+    Screen screen;
+    int mode;
 
-    if (getExecuteMode(argc, argv) == EXECUTE_TEST_MODE) { return test(); }
+    initGame(&game, time(NULL));
+    memset(&screen, 0, sizeof(screen));
+    game.screen = &screen;
+    mode = getExecuteMode(argc, argv, &game);
+
+    if (mode == EXECUTE_TEST_MODE) { return test(); }
+    if (mode == EXECUTE_SIM_MODE) { return simulate(argc - 2, argv + 2); }
+    if (mode == EXECUTE_AI_MODE) { return playAI(argc - 2, argv + 2); }
+    if (mode == EXECUTE_REPLAY_MODE) { return replayFiles(argc - 2, argv + 2); }
+    if (mode == EXECUTE_BENCH_MODE) { return bench(argc - 2, argv + 2); }
+    if (mode == EXECUTE_TRAIN_MODE) { return train(argc - 2, argv + 2); }
+    if (mode == EXECUTE_SERVE_MODE) { return serve(argc - 2, argv + 2); }
+    if (mode == EXECUTE_VERIFY_MODE) { return verify(argc - 2, argv + 2); }
+    if (mode == EXECUTE_TABLEBASE_MODE) { return tablebase(argc - 2, argv + 2); }
+    if (mode == EXECUTE_STATS_MODE) { return summarizeAnalytics(argc - 2, argv + 2); }
 
     printf("\033[?25l\033[2J");
 
     // @brief 컨트롤 C에 대한 이벤트를 받을 핸들러 등록
     signal(SIGINT, signal_callback_handler);
+    if (statsEnabled) {
+        signal(SIGUSR1, requestStats);
+    }
 
-    initBoard(board);
+    drawBoard(&game);
     setBufferedInput(false);
 
     // @brief 게임의 실제 진행이 이루어지는 부분
-    KeyInputProcess(board);
-    
+    KeyInputProcess(&game);
+    if (game.analysis != NULL) {
+        freeAnalysis(game.analysis);
+    }
+
     setBufferedInput(true);
 
     printf("\033[?25h\033[m");
+    printStats(stderr);
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return terminateRequested ? SIGINT : EXIT_SUCCESS;
+}
+#endif